@@ -17,7 +17,9 @@
 
 #pragma once
 
+#include "LuaConstants.hpp"
 #include <iostream>
+#include <type_traits>
 
 namespace LuaLink {
     template<typename T>
@@ -61,9 +63,21 @@ namespace LuaLink {
         
         static void RegisterAll() {
             for(auto elt = AutoClassList().m_begin; elt != nullptr; elt = elt->cdr)
-                (*elt->car.m_fn_reg_class)(elt->car.m_name, elt->car.m_is_inheritance_allowed);
+                elt->car.RegisterClass();
         }
         
+        static WeakLinkedList<LuaAutoClass>::node* GetAll() {
+            return AutoClassList().m_begin;
+        }
+        
+        // // Registers this class on its own, lazy registration does this when the class is first used
+        void RegisterClass() const {
+            (*m_fn_reg_class)(m_name, m_is_inheritance_allowed);
+        }
+        
+        const char* GetName() const { return m_name; }
+        fn_register_class_t GetRegisterFunction() const { return m_fn_reg_class; }
+        
     private:
         
         static WeakLinkedList<LuaAutoClass>& AutoClassList() {
@@ -82,9 +96,20 @@ namespace LuaLink {
     public:
         template<typename _RetType, typename... _ArgTypes>
         LuaAutoFunction(_RetType(*fn)(_ArgTypes...), const char* name) :
+        Register(RegisterImpl<_RetType, _ArgTypes...>),
         m_fn(reinterpret_cast<void(*)(void)>(fn)),
+        m_name(name)
+        {
+            
+        }
+        
+        // // Lambdas and functors defined at namespace scope, copied into Lua when registered
+        template<typename F, typename = typename std::enable_if<std::is_class<F>::value>::type>
+        LuaAutoFunction(const F& functor, const char* name) :
+        Register(RegisterFunctorImpl<F>),
+        m_fn(nullptr),
         m_name(name),
-        Register(RegisterImpl<_RetType, _ArgTypes...>)
+        m_pFunctor(&functor)
         {
             
         }
@@ -104,6 +129,7 @@ namespace LuaLink {
         void(*Register)(LuaAutoFunction&);
         void(*m_fn)(void);
         const char* m_name;
+        const void* m_pFunctor = nullptr;
         
         static WeakLinkedList<LuaAutoFunction>& AutoFunctionList() {
             static WeakLinkedList<LuaAutoFunction> s_AutoFunctionList;
@@ -114,6 +140,47 @@ namespace LuaLink {
         static void RegisterImpl(LuaAutoFunction& self) {
             LuaFunction::Register(reinterpret_cast<_RetType(*)(_ArgTypes...)>(self.m_fn), self.m_name);
         }
+        
+        template<typename F>
+        static void RegisterFunctorImpl(LuaAutoFunction& self) {
+            LuaFunction::Register(*static_cast<const F*>(self.m_pFunctor), self.m_name);
+        }
+    };
+    
+    class LuaAutoConstants {
+    public:
+        typedef void(*fn_register_t)(const char*);
+        
+        LuaAutoConstants(const char* name, fn_register_t fn_constants, LuaConstantsMode mode) :
+        m_name(name),
+        m_fn_constants(fn_constants),
+        m_mode(mode)
+        {
+            
+        }
+        
+        static WeakLinkedList<LuaAutoConstants>::node* AddNode(WeakLinkedList<LuaAutoConstants>::node* node) {
+            auto result = AutoConstantsList().m_begin;
+            AutoConstantsList().m_begin = node;
+            return result;
+        }
+        
+        static void RegisterAll() {
+            for(auto elt = AutoConstantsList().m_begin; elt != nullptr; elt = elt->cdr){
+                (*elt->car.m_fn_constants)(elt->car.m_name);
+                LuaConstants::SetMode(elt->car.m_name, elt->car.m_mode);
+            }
+        }
+        
+    private:
+        const char* m_name;
+        fn_register_t m_fn_constants;
+        LuaConstantsMode m_mode;
+        
+        static WeakLinkedList<LuaAutoConstants>& AutoConstantsList() {
+            static WeakLinkedList<LuaAutoConstants> s_AutoConstantsList;
+            return s_AutoConstantsList;
+        }
     };
 }
 
@@ -140,21 +207,55 @@ LuaClass<CLASS>::Register, \
 IS_INHERITANCE_ALLOWED), \
 LuaAutoClass::AddNode(&CLASS##_LuaClass_WLLN) };
 
+//Ownership of objects pushed as CLASS* without an explicit policy (LuaOwnership::Cpp unless specified)
+#define LUACLASS_OWNERSHIP(CLASS,OWNERSHIP) \
+namespace LuaLink { template<> struct LuaDefaultOwnership<CLASS> { static const LuaOwnership value = OWNERSHIP; }; }
+
+//What reading an integer that doesn't fit TYPE does (Reject, Clamp or Wrap), at namespace scope
+#define LUAOVERFLOW(TYPE,POLICY) \
+namespace LuaLink { template<> struct LuaOverflowPolicy<TYPE> { static const LuaOverflow value = LuaOverflow::POLICY; }; }
+
 //Lua nonstatic members
 #define LUAMEMBERS(CLASS) void CLASS::RegisterVariables(CLASS* self)
 #define LUAMEMBER_1(X) LUAMEMBER_2(X, #X)
 #define LUAMEMBER_2(X,NAME) LuaLink::LuaVariable::Register(self->X, NAME);
 #define LUAMEMBER(...) ID(GET_MACRO_2(__VA_ARGS__, LUAMEMBER_2, LUAMEMBER_1)(__VA_ARGS__))
 
+//Structs marshalled by value as tables, LUASTRUCT(CLASS) { LUAFIELD(x); LUAFIELD(y, "Y"); } at namespace scope
+#define LUASTRUCT(STRUCT) \
+namespace LuaLink { template<> struct LuaStructFields<STRUCT> { \
+static const bool value = true; \
+template<typename V> static void visit(V& v, STRUCT& self); }; } \
+template<typename V> void LuaLink::LuaStructFields<STRUCT>::visit(V& v, STRUCT& self)
+#define LUAFIELD(...) ID(GET_MACRO_2(__VA_ARGS__, LUAFIELD_2, LUAFIELD_1)(__VA_ARGS__))
+#define LUAFIELD_1(X) LUAFIELD_2(X, #X)
+#define LUAFIELD_2(X,NAME) v(NAME, self.X);
+
 //Lua statics and methods
 #define LUASTATICMETHOD(...) ID(GET_MACRO_2(__VA_ARGS__, LUASTATICMETHOD_2, LUASTATICMETHOD_1)(__VA_ARGS__))
 #define LUASTATICMETHOD_1(X) LUASTATICMETHOD_2(X, #X)
 #define LUASTATICMETHOD_2(X,NAME) LuaLink::LuaStaticMethod<type>::Register(X,NAME);
 
+#define LUASTATICMETHOD_TRUSTED(...) ID(GET_MACRO_2(__VA_ARGS__, LUASTATICMETHOD_TRUSTED_2, LUASTATICMETHOD_TRUSTED_1)(__VA_ARGS__))
+#define LUASTATICMETHOD_TRUSTED_1(X) LUASTATICMETHOD_TRUSTED_2(X, #X)
+#define LUASTATICMETHOD_TRUSTED_2(X,NAME) LuaLink::LuaStaticMethod<type>::RegisterTrusted(X,NAME);
+
+#define LUACONSTRUCTOR(...) LuaLink::LuaStaticMethod<type>::RegisterConstructor<__VA_ARGS__>();
+
+#define LUAPOOL(CAPACITY) LuaLink::LuaClass<type>::SetPoolCapacity(CAPACITY);
+
+#define LUAEXTERNALSIZE(BYTES) LuaLink::LuaClass<type>::SetExternalSize(BYTES);
+
+#define LUAINHERITANCE(MODE) LuaLink::LuaClass<type>::SetInheritance(LuaLink::LuaInheritance::MODE);
+
 #define LUAMETHOD(...) ID(GET_MACRO_2(__VA_ARGS__, LUAMETHOD_2, LUAMETHOD_1)(__VA_ARGS__))
 #define LUAMETHOD_1(X) LUAMETHOD_2(X, #X)
 #define LUAMETHOD_2(X,NAME) LuaLink::LuaMethod<type>::Register(&type::X,NAME);
 
+#define LUAMETHOD_TRUSTED(...) ID(GET_MACRO_2(__VA_ARGS__, LUAMETHOD_TRUSTED_2, LUAMETHOD_TRUSTED_1)(__VA_ARGS__))
+#define LUAMETHOD_TRUSTED_1(X) LUAMETHOD_TRUSTED_2(X, #X)
+#define LUAMETHOD_TRUSTED_2(X,NAME) LuaLink::LuaMethod<type>::RegisterTrusted(&type::X,NAME);
+
 #define LUASTATIC(...) ID(GET_MACRO_2(__VA_ARGS__, LUASTATIC_2, LUASTATIC_1)(__VA_ARGS__))
 #define LUASTATIC_1(X) LUASTATIC_2(X, #X)
 #define LUASTATIC_2(X,NAME) LuaLink::LuaVariable::Register(X,NAME);
@@ -165,6 +266,20 @@ LuaAutoClass::AddNode(&CLASS##_LuaClass_WLLN) };
 #define LUAFUNCTION(...) ID(GET_MACRO_2(__VA_ARGS__, LUAFUNCTION_2, LUAFUNCTION_1)(__VA_ARGS__))
 #define LUAFUNCTION_1(FN) LUAFUNCTION_2(FN,#FN)
 #define LUAFUNCTION_2(FN,NAME) \
-WeakLinkedList<LuaLink::LuaAutoFunction>::node FN##_LuaFunction_WLLN ( \
+WeakLinkedList<LuaLink::LuaAutoFunction>::node FN##_LuaFunction_WLLN { \
 LuaAutoFunction(FN,NAME), \
-nullptr );
+LuaAutoFunction::AddNode(&FN##_LuaFunction_WLLN) };
+
+//Lua constant tables, LUACONSTANTS(EventId) { LUACONSTANT(EventId::Spawn); LUACONSTANT(MAX_PLAYERS, "MaxPlayers"); } at namespace scope
+//LUACONSTANTS(EventId, Frozen) makes the table read-only
+#define LUACONSTANTS(...) ID(GET_MACRO_2(__VA_ARGS__, LUACONSTANTS_2, LUACONSTANTS_1)(__VA_ARGS__))
+#define LUACONSTANTS_1(NAME) LUACONSTANTS_2(NAME, Plain)
+#define LUACONSTANTS_2(NAME,MODE) \
+static void NAME##_LuaConstants(const char* table); \
+WeakLinkedList<LuaLink::LuaAutoConstants>::node NAME##_LuaConstants_WLLN { \
+LuaAutoConstants(#NAME, NAME##_LuaConstants, LuaLink::LuaConstantsMode::MODE), \
+LuaAutoConstants::AddNode(&NAME##_LuaConstants_WLLN) }; \
+static void NAME##_LuaConstants(const char* table)
+#define LUACONSTANT(...) ID(GET_MACRO_2(__VA_ARGS__, LUACONSTANT_2, LUACONSTANT_1)(__VA_ARGS__))
+#define LUACONSTANT_1(X) LUACONSTANT_2(X, LuaLink::detail::UnqualifiedName(#X))
+#define LUACONSTANT_2(X,NAME) LuaLink::LuaConstants::Register(table, NAME, X);
@@ -0,0 +1,89 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "LuaCompat.h"
+#include <cstddef>
+
+namespace LuaLink
+{
+	namespace detail {
+		// // Layout of a bundle written by LuaLinkPack, all integers are 32-bit little endian
+		// //     header:  magic[8], format version, LUA_VERSION_NUM, flags, number of modules
+		// //     index:   one entry per module sorted by name: name offset, name size, chunk offset, chunk size
+		// //     then the names and chunks, offsets are relative to the start of the bundle
+		struct BundleFormat
+		{
+			static const size_t HeaderSize = 24;
+			static const size_t EntrySize = 16;
+			static const unsigned int Version = 1;
+
+			static const unsigned int Precompiled = 1; //Chunks are bytecode, only loadable by the Lua version that wrote them
+			static const unsigned int LuaJIT = 2;
+
+			static const char* Magic(void) { return "LLBUNDLE"; }
+		};
+	}
+
+	// // Read-only archive of Lua modules, usually produced by LuaLinkPack
+	// // Once added to a LuaScript, require loads modules from the bundle, each one only when it's required for the first time
+	class LuaBundle final
+	{
+	public:
+		LuaBundle(void);
+		~LuaBundle(void);
+
+		// // Maps a bundle file into memory, throws a LuaLoadException if it can't be opened or wasn't written for this Lua version
+		void Open(const char* filename);
+
+		// // Uses a bundle that is already in memory (e.g. embedded with LuaLinkPack --embed), the memory has to outlive the bundle
+		void Attach(const void* pData, size_t size);
+
+		// // Unmaps the bundle, call LuaScript::RemoveBundle first if it was added to a state that is still open
+		void Close(void);
+
+		size_t GetModuleCount(void) const;
+		bool HasModule(const char* name) const;
+
+	private:
+		friend class LuaScript;
+
+		// // Validates the header, throws a LuaLoadException naming source if it's not a usable bundle
+		void Validate(const char* source);
+
+		// // Binary search in the index, returns false if there is no such module
+		bool Find(const char* name, const char*& pChunk, size_t& chunkSize) const;
+
+		// // Entry of package.searchers, the bundle is its upvalue
+		static int Searcher(lua_State* L);
+
+		const unsigned char* m_pData;
+		size_t m_Size;
+		size_t m_Count;
+		void* m_pMapping; //Memory mapped by Open, nullptr for attached bundles
+#ifdef _WIN32
+		void* m_hFile;
+		void* m_hMapping;
+#endif
+
+		LuaBundle(const LuaBundle& src) = delete;
+		LuaBundle& operator=(const LuaBundle& src) = delete;
+	};
+}
+
+#include "LuaBundle.inl"
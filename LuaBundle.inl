@@ -0,0 +1,240 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "LuaScript.hpp"
+
+#ifdef LUALINK_DEFINE
+
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace LuaLink
+{
+	namespace detail {
+		namespace LuaBundle {
+			//Bundles are read through memory mappings, which don't have to be aligned
+			unsigned int ReadU32(const unsigned char* p)
+			{
+				return static_cast<unsigned int>(p[0]) | static_cast<unsigned int>(p[1]) << 8 | static_cast<unsigned int>(p[2]) << 16 | static_cast<unsigned int>(p[3]) << 24;
+			}
+		}
+	}
+
+	LuaBundle::LuaBundle(void) : m_pData(nullptr), m_Size(0), m_Count(0), m_pMapping(nullptr)
+#ifdef _WIN32
+		, m_hFile(nullptr), m_hMapping(nullptr)
+#endif
+	{}
+
+	LuaBundle::~LuaBundle(void)
+	{
+		Close();
+	}
+
+	void LuaBundle::Open(const char* filename)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if(hFile == INVALID_HANDLE_VALUE)
+			throw LuaLoadException(("Unable to open bundle " + std::string(filename)).c_str());
+
+		LARGE_INTEGER size;
+		HANDLE hMapping = GetFileSizeEx(hFile, &size) && size.QuadPart > 0 ? CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		void* pView = hMapping ? MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if(!pView){
+			if(hMapping)
+				CloseHandle(hMapping);
+			CloseHandle(hFile);
+			throw LuaLoadException(("Unable to map bundle " + std::string(filename)).c_str());
+		}
+
+		m_hFile = hFile;
+		m_hMapping = hMapping;
+		m_Size = static_cast<size_t>(size.QuadPart);
+#else
+		int fd = open(filename, O_RDONLY);
+		if(fd < 0)
+			throw LuaLoadException(("Unable to open bundle " + std::string(filename)).c_str());
+
+		struct stat st;
+		void* pView = fstat(fd, &st) == 0 && st.st_size > 0 ? mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		close(fd); //The mapping stays valid
+		if(pView == MAP_FAILED)
+			throw LuaLoadException(("Unable to map bundle " + std::string(filename)).c_str());
+
+		m_Size = static_cast<size_t>(st.st_size);
+#endif
+
+		m_pMapping = pView;
+		m_pData = static_cast<const unsigned char*>(pView);
+		Validate(filename);
+	}
+
+	void LuaBundle::Attach(const void* pData, size_t size)
+	{
+		Close();
+
+		m_pData = static_cast<const unsigned char*>(pData);
+		m_Size = size;
+		Validate("in memory");
+	}
+
+	void LuaBundle::Close(void)
+	{
+		if(m_pMapping){
+#ifdef _WIN32
+			UnmapViewOfFile(m_pMapping);
+			CloseHandle(m_hMapping);
+			CloseHandle(m_hFile);
+			m_hMapping = nullptr;
+			m_hFile = nullptr;
+#else
+			munmap(m_pMapping, m_Size);
+#endif
+		}
+
+		m_pMapping = nullptr;
+		m_pData = nullptr;
+		m_Size = 0;
+		m_Count = 0;
+	}
+
+	size_t LuaBundle::GetModuleCount(void) const
+	{
+		return m_Count;
+	}
+
+	bool LuaBundle::HasModule(const char* name) const
+	{
+		const char* pChunk;
+		size_t chunkSize;
+		return Find(name, pChunk, chunkSize);
+	}
+
+	void LuaBundle::Validate(const char* source)
+	{
+		using detail::BundleFormat;
+		using detail::LuaBundle::ReadU32;
+
+		std::string error;
+		if(m_Size < BundleFormat::HeaderSize || memcmp(m_pData, BundleFormat::Magic(), 8) != 0)
+			error = "Not a LuaLink bundle: ";
+		else if(ReadU32(m_pData + 8) != BundleFormat::Version)
+			error = "Unsupported bundle format version: ";
+		else{
+			unsigned int flags = ReadU32(m_pData + 16);
+			m_Count = ReadU32(m_pData + 20);
+
+#ifdef LUAJIT_VERSION
+			bool isOtherVM = (flags & BundleFormat::LuaJIT) == 0;
+#else
+			bool isOtherVM = (flags & BundleFormat::LuaJIT) != 0;
+#endif
+			if((flags & BundleFormat::Precompiled) && (ReadU32(m_pData + 12) != LUA_VERSION_NUM || isOtherVM))
+				error = "Bundle was precompiled for another Lua version: ";
+			else if(m_Count > (m_Size - BundleFormat::HeaderSize) / BundleFormat::EntrySize)
+				error = "Corrupt bundle index: ";
+			else{
+				//Every name and chunk has to lie within the bundle
+				for(size_t i = 0; i < m_Count && error.empty(); ++i){
+					const unsigned char* pEntry = m_pData + BundleFormat::HeaderSize + i * BundleFormat::EntrySize;
+					for(int field = 0; field < 16; field += 8){
+						size_t offset = ReadU32(pEntry + field), size = ReadU32(pEntry + field + 4);
+						if(offset > m_Size || size > m_Size - offset)
+							error = "Corrupt bundle index: ";
+					}
+				}
+			}
+		}
+
+		if(!error.empty()){
+			Close();
+			throw LuaLoadException((error + source).c_str());
+		}
+	}
+
+	bool LuaBundle::Find(const char* name, const char*& pChunk, size_t& chunkSize) const
+	{
+		using detail::BundleFormat;
+		using detail::LuaBundle::ReadU32;
+
+		size_t nameSize = strlen(name);
+		size_t first = 0, last = m_Count;
+
+		while(first < last){
+			size_t mid = first + (last - first) / 2;
+			const unsigned char* pEntry = m_pData + BundleFormat::HeaderSize + mid * BundleFormat::EntrySize;
+
+			size_t entryNameSize = ReadU32(pEntry + 4);
+			int cmp = memcmp(name, m_pData + ReadU32(pEntry), nameSize < entryNameSize ? nameSize : entryNameSize);
+			if(cmp == 0)
+				cmp = nameSize < entryNameSize ? -1 : nameSize > entryNameSize ? 1 : 0;
+
+			if(cmp == 0){
+				pChunk = reinterpret_cast<const char*>(m_pData + ReadU32(pEntry + 8));
+				chunkSize = ReadU32(pEntry + 12);
+				return true;
+			}
+
+			if(cmp < 0)
+				last = mid;
+			else
+				first = mid + 1;
+		}
+
+		return false;
+	}
+
+	int LuaBundle::Searcher(lua_State* L)
+	{
+		auto pBundle = static_cast<const LuaBundle*>(lua_touserdata(L, lua_upvalueindex(1)));
+		const char* name = luaL_checkstring(L, 1);
+
+		const char* pChunk;
+		size_t chunkSize;
+		if(!pBundle->Find(name, pChunk, chunkSize)){
+#if LUA_VERSION_NUM >= 504
+			lua_pushfstring(L, "no module '%s' in bundle", name);
+#else
+			lua_pushfstring(L, "\n\tno module '%s' in bundle", name);
+#endif
+			return 1;
+		}
+
+		//Compiled (or only undumped) on first require, package.loaded caches the module afterwards
+		lua_pushfstring(L, "@%s", name);
+		if(luaL_loadbuffer(L, pChunk, chunkSize, lua_tostring(L, -1)) != 0)
+			return luaL_error(L, "error loading module '%s' from bundle:\n\t%s", name, lua_tostring(L, -1));
+
+		lua_pushstring(L, name); //Passed to the loader as its second argument
+		return 2;
+	}
+}
+
+#endif
@@ -0,0 +1,92 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "LuaCompat.h"
+
+namespace LuaLink
+{
+	namespace detail {
+		// // Anchors a Lua function in the registry, the untyped part of LuaCallback
+		class CallbackRef final
+		{
+		public:
+			CallbackRef(void);
+			// // Anchors the function at idx
+			CallbackRef(lua_State* L, int idx);
+			~CallbackRef(void);
+			CallbackRef(const CallbackRef& src);
+			CallbackRef(CallbackRef&& src);
+			CallbackRef& operator=(const CallbackRef& src);
+			CallbackRef& operator=(CallbackRef&& src);
+
+			// // True while the function is anchored in the current state
+			bool IsValid(void) const;
+			void Release(void);
+
+			// // Pushes the function (nil if released) on the stack of L
+			void Push(lua_State* L) const;
+
+			// // Pushes the function on the stack of LuaScript's state, returns the stack top to restore afterwards
+			// // Throws a LuaCallException if the callback was released
+			int PushFunction(lua_State*& L) const;
+
+			// // Calls the function pushed by PushFunction with the arguments above it, throws a LuaCallException if it raises an error
+			static void Run(lua_State* L, int top, int nrOfResults);
+
+			// // Throws a LuaCallException for a value returned by the callback that doesn't convert to the expected type
+			static void ThrowReturnTypeMismatch(const char* typeName);
+
+		private:
+			lua_State* m_pLuaState;
+			int m_Ref;
+		};
+
+		template<typename _RetType> struct CallbackResult;
+	}
+
+	template<typename _Signature>
+	class LuaCallback;
+
+	template<typename _RetType, typename... _ArgTypes>
+	// // Lua function received as argument of a bound function (take it by value), or read from the stack
+	// // Keeps the function alive until it is released or destroyed, calling it costs no lookup by name
+	// // Copies refer to the same function, calls run in LuaScript's state under its budget
+	class LuaCallback<_RetType(_ArgTypes...)>
+	{
+	public:
+		LuaCallback(void) {}
+		explicit LuaCallback(detail::CallbackRef ref) : m_Ref(std::move(ref)) {}
+
+		// // Calls the function, throws a LuaCallException if it raises an error or returns something that doesn't convert to _RetType
+		_RetType operator()(_ArgTypes... args) const;
+
+		bool IsValid(void) const { return m_Ref.IsValid(); }
+		explicit operator bool(void) const { return m_Ref.IsValid(); }
+
+		// // Lets Lua collect the function, call before the callback would outlive its usefulness (e.g. on unsubscribe)
+		void Release(void) { m_Ref.Release(); }
+
+		const detail::CallbackRef& GetRef(void) const { return m_Ref; }
+
+	private:
+		detail::CallbackRef m_Ref;
+	};
+}
+
+#include "LuaCallback.inl"
@@ -0,0 +1,197 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "LuaScript.hpp"
+#include "LuaStack.hpp"
+
+#include <typeinfo>
+#include <utility>
+
+namespace LuaLink
+{
+	namespace detail {
+		template<typename _RetType>
+		struct CallbackResult
+		{
+			static _RetType get(lua_State* L, int top)
+			{
+				bool isOk = true;
+				auto ret = Results<_RetType>::get(L, isOk);
+				lua_settop(L, top);
+				if(!isOk)
+					CallbackRef::ThrowReturnTypeMismatch(typeid(_RetType).name());
+				return ret;
+			}
+		};
+
+		template<>
+		struct CallbackResult<void>
+		{
+			static void get(lua_State* L, int top) { lua_settop(L, top); }
+		};
+
+		template<typename _RetType>
+		struct CallbackResultCount
+		{
+			static const int value = ResultCount<_RetType>::value;
+		};
+
+		template<>
+		struct CallbackResultCount<void>
+		{
+			static const int value = 0;
+		};
+
+		template<typename _Signature>
+		//Only functions are accepted, so overloads taking a callback are told apart from the others
+		struct Getter<LuaCallback<_Signature>>
+		{
+			static LuaCallback<_Signature> get(lua_State* pLua, int idx, bool& isOk)
+			{
+				if(lua_type(pLua, idx) != LUA_TFUNCTION){
+					isOk = false;
+					return LuaCallback<_Signature>();
+				}
+				return LuaCallback<_Signature>(CallbackRef(pLua, idx));
+			}
+		};
+
+		template<typename _Signature>
+		struct Pusher<LuaCallback<_Signature>>
+		{
+			static void push(lua_State* pLua, const LuaCallback<_Signature>& data) { data.GetRef().Push(pLua); }
+		};
+	}
+
+	template<typename _RetType, typename... _ArgTypes>
+	_RetType LuaCallback<_RetType(_ArgTypes...)>::operator()(_ArgTypes... args) const
+	{
+		lua_State* L;
+		int top = m_Ref.PushFunction(L);
+
+		LuaStack::pushStack<_ArgTypes...>(L, args...);
+		detail::CallbackRef::Run(L, top, detail::CallbackResultCount<_RetType>::value);
+
+		return detail::CallbackResult<_RetType>::get(L, top);
+	}
+}
+
+#ifdef LUALINK_DEFINE
+
+namespace LuaLink
+{
+	namespace detail {
+		CallbackRef::CallbackRef(void) : m_pLuaState(nullptr), m_Ref(LUA_NOREF) {}
+
+		CallbackRef::CallbackRef(lua_State* L, int idx) : m_pLuaState(LuaScript::GetLuaState()), m_Ref(LUA_NOREF)
+		{
+			//The registry is shared by all threads (coroutines) of the state
+			lua_pushvalue(L, idx);
+			m_Ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		}
+
+		CallbackRef::~CallbackRef(void)
+		{
+			Release();
+		}
+
+		CallbackRef::CallbackRef(const CallbackRef& src) : m_pLuaState(nullptr), m_Ref(LUA_NOREF)
+		{
+			*this = src;
+		}
+
+		CallbackRef::CallbackRef(CallbackRef&& src) : m_pLuaState(src.m_pLuaState), m_Ref(src.m_Ref)
+		{
+			src.m_pLuaState = nullptr;
+			src.m_Ref = LUA_NOREF;
+		}
+
+		CallbackRef& CallbackRef::operator=(const CallbackRef& src)
+		{
+			if(this == &src)
+				return *this;
+
+			Release();
+			if(src.IsValid()){
+				src.Push(src.m_pLuaState);
+				m_Ref = luaL_ref(src.m_pLuaState, LUA_REGISTRYINDEX);
+				m_pLuaState = src.m_pLuaState;
+			}
+			return *this;
+		}
+
+		CallbackRef& CallbackRef::operator=(CallbackRef&& src)
+		{
+			if(this != &src){
+				Release();
+				m_pLuaState = src.m_pLuaState;
+				m_Ref = src.m_Ref;
+				src.m_pLuaState = nullptr;
+				src.m_Ref = LUA_NOREF;
+			}
+			return *this;
+		}
+
+		bool CallbackRef::IsValid(void) const
+		{
+			return m_Ref != LUA_NOREF && m_pLuaState && m_pLuaState == LuaScript::GetLuaState();
+		}
+
+		void CallbackRef::Release(void)
+		{
+			//References into a state that was closed or replaced are gone already
+			if(IsValid())
+				luaL_unref(m_pLuaState, LUA_REGISTRYINDEX, m_Ref);
+
+			m_pLuaState = nullptr;
+			m_Ref = LUA_NOREF;
+		}
+
+		void CallbackRef::Push(lua_State* L) const
+		{
+			if(IsValid())
+				lua_rawgeti(L, LUA_REGISTRYINDEX, m_Ref);
+			else
+				lua_pushnil(L);
+		}
+
+		int CallbackRef::PushFunction(lua_State*& L) const
+		{
+			if(!IsValid())
+				throw LuaCallException("Callback was released, or belongs to a closed state");
+
+			L = m_pLuaState;
+			int top = lua_gettop(L);
+			lua_rawgeti(L, LUA_REGISTRYINDEX, m_Ref);
+			return top;
+		}
+
+		void CallbackRef::Run(lua_State* L, int top, int nrOfResults)
+		{
+			Trace::Scope traceScope(Trace::Lua, nullptr, "(callback)");
+			if(LuaScript::ProtectedCall(lua_gettop(L) - top - 1, nrOfResults) != 0)
+				LuaScript::ThrowCallError(top);
+		}
+
+		void CallbackRef::ThrowReturnTypeMismatch(const char* typeName)
+		{
+			throw LuaCallException(("Error: Expected return type " + std::string(typeName) + " does not match the value returned by callback").c_str());
+		}
+	}
+}
+
+#endif
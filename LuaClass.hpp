@@ -19,8 +19,63 @@
 
 #include "LuaFunction.hpp"
 
+#include <memory>
+#include <type_traits>
+
 namespace LuaLink
 {
+	// // Who is responsible for destroying a C++ object that is exposed to Lua
+	enum class LuaOwnership
+	{
+		Lua,		//Deleted when Lua collects the wrapper, used for objects created by constructors registered as "new"
+		Cpp,		//Borrowed, C++ keeps the object alive for as long as Lua may use it
+		Shared,		//The wrapper holds a std::shared_ptr<T>
+		Intrusive	//The wrapper holds a reference through LuaIntrusiveRefCount<T>
+	};
+
+	template<typename T>
+	// // Ownership used when a T* is pushed without specifying one (e.g. returned by a bound function), specialize with LUACLASS_OWNERSHIP
+	struct LuaDefaultOwnership { static const LuaOwnership value = LuaOwnership::Cpp; };
+
+	template<typename T>
+	// // Retains and releases intrusively refcounted objects, specialize for classes that don't use AddRef/Release
+	struct LuaIntrusiveRefCount
+	{
+		static void AddRef(T* pObj) { pObj->AddRef(); }
+		static void Release(T* pObj) { pObj->Release(); }
+	};
+
+	// // How classes derived in Lua (Class.inherit()) look up inherited members
+	enum class LuaInheritance
+	{
+		Chained,	//Each level is a metatable with __index, lookups walk the chain
+		Flattened	//Inherited members are cached in each derived class, lookups cost the same at any depth
+	};
+
+	// // Effectiveness of the object pool of a class
+	struct LuaPoolStats
+	{
+		unsigned long long Hits; //Constructions that reused a pooled object
+		unsigned long long Misses; //Constructions that found the pool empty
+		unsigned long long Recycled; //Collected objects that were added to the pool
+		unsigned long long Dropped; //Collected objects that were freed because the pool was full
+	};
+
+	namespace detail {
+		template<typename T>
+		// // Contents of the core_ userdata of every object wrapper
+		struct ObjectHolder
+		{
+			T* pObj; //Must remain the first member, method wrappers read the userdata as T**
+			void(*pfnRelease)(ObjectHolder*); //Called by __gc, nullptr for borrowed objects
+			size_t ExternalSize; //Memory credited to the collector when the object was constructed from Lua
+			typename std::aligned_storage<sizeof(std::shared_ptr<T>), std::alignment_of<std::shared_ptr<T>>::value>::type SharedStorage;
+		};
+
+		template<typename T, LuaOwnership _Ownership> struct ObjectOwnership;
+		template<typename T> struct ObjectPool;
+	}
+
 	template <typename T> 
 	class LuaClass 
 	{
@@ -28,6 +83,30 @@ namespace LuaLink
         // // Registers Class T in the Lua environment
         static void Register(const char* className, bool bAllowInheritance = true);
         static void Register(const char* className, bool bAllowInheritance, void(*fn_static_reg)(void), void(*fn_inst_reg)(void*));
+        
+        template<LuaOwnership _Ownership = LuaDefaultOwnership<T>::value>
+        // // Pushes the wrapper of pObj, an object that was pushed before gets its existing wrapper back (ownership is decided by the first push)
+        // // Pushes nil for nullptr, and a light userdata if T isn't registered with the state
+        static void Push(lua_State* L, T* pObj);
+        
+        // // Pushes the wrapper of the object pObj points to, the wrapper keeps it alive until it is collected
+        static void Push(lua_State* L, std::shared_ptr<T> pObj);
+        
+        // // Severs the link between pObj and its Lua wrapper, call this before destroying a borrowed object Lua may still refer to
+        static void Detach(T* pObj);
+        
+        // // Keeps up to capacity collected objects for reuse by the next constructions, 0 (the default) disables pooling
+        // // Only applies to objects constructed in place (registered with RegisterConstructor/LUACONSTRUCTOR)
+        static void SetPoolCapacity(unsigned int capacity);
+        static const LuaPoolStats& GetPoolStats(void);
+        
+        // // Memory owned by each object outside of the Lua heap (buffers, meshes, ...), so the collector paces itself by the real size of objects
+        // // Credited when an object is constructed from Lua and released when it is collected
+        static void SetExternalSize(size_t bytes);
+        static void SetExternalSizeCallback(size_t(*pfnSize)(const T&));
+        
+        // // Selects how Lua-side subclasses look up inherited members, has to be set before the class is registered
+        static void SetInheritance(LuaInheritance inheritance);
 	
 	private:
 		// // This is the name the class is registered with in Lua
@@ -35,23 +114,68 @@ namespace LuaLink
         
         //This function will be used to register instances of this class in Lua
         static void(*s_fn_inst_reg)(T*);
+        
+        static LuaInheritance s_Inheritance;
+        
+        static size_t s_ExternalSize;
+        static size_t(*s_pfnExternalSize)(const T&);
+        
+        static int s_MetricsCounter; //Objects wrapped, followed by objects released
 
 		// // Creates new object in C++ and pushes it to the Lua stack
 		static int ConstructorWrapper(lua_State * L);
 		static int ConstructorWrapper(lua_State * L, detail::WrapperDoubleArg pWrapper, void* cb, detail::ArgErrorCbType onArgError);
 
+		// // Credits the external size of the object constructed for the wrapper on top of the stack to the collector
+		static void CreditExternalSize(lua_State* L);
+
+		// // Releases an object according to its ownership, and the memory credited for it
+		static void Release(detail::ObjectHolder<T>* pHolder);
+
 		// // Metamethod, called when garbage collector gets rid of our object
 		static int gc_obj(lua_State * L);	
 
+#ifdef LUALINK_USERDATA_GC
+		// // Metamethod of object holders where tables can't have finalizers (LuaJIT), releases the object
+		static int gc_holder(lua_State* L);
+		static char s_HolderMetatableKey;
+#endif
+
 		// // Metamethod, called when converting our object to a string
 		static int to_string(lua_State* L);
 
+		// // Pushes the cached wrapper of pObj and returns true, returns false without pushing anything if there is none
+		static bool PushCached(lua_State* L, T* pObj);
+
+		// // Creates and pushes a new wrapper for pObj, adds it to the identity cache and returns its holder
+		static detail::ObjectHolder<T>* PushNewWrapper(lua_State* L, T* pObj);
+
+		// // Replaces the core_ userdata on top of the stack by a new wrapper for it, adds it to the identity cache
+		static void WrapHolder(lua_State* L);
+
+		// // Readies the recycled wrapper on top of the stack for its new object
+		static void ReviveWrapper(lua_State* L);
+
+		// // Pushes the weak-valued table that maps every T* exposed to Lua to its wrapper
+		static void PushIdentityCache(lua_State* L);
+
 		// // Returns new table that derives from the table linked to this class
 		static int returnDerived(lua_State* L);
 
 		// // Disables inheritance for this class
 		static int noInheritance(lua_State* L);
 
+		// // Flattened inheritance: returnDerived, turns the table at frontIdx into a class deriving from the class whose metatable is at baseMetaIdx (0 for none)
+		static int returnFlattenedDerived(lua_State* L);
+		static void MakeFlattened(lua_State* L, int frontIdx, int baseMetaIdx);
+
+		// // Flattened inheritance: resolves a miss in a view through the base class and caches it, records assignments to a class
+		static int flattenedResolve(lua_State* L);
+		static int flattenedNewIndex(lua_State* L);
+
+		// // Removes a key that was cached from this class from the views of all classes deriving from it
+		static void EvictFromDescendants(lua_State* L, int metaIdx, int keyIdx);
+
 		//Disable default constructor, destructor, copy constructor & assignment operator
 		LuaClass(void) = delete;
 		~LuaClass(void) = delete;
@@ -20,6 +20,8 @@
 #include "LuaVariable.hpp"
 #include "LuaScript.hpp"
 
+#include <new>
+
 namespace LuaLink
 {
     template<typename T>
@@ -43,11 +45,296 @@ namespace LuaLink
         }
     };
 
+    namespace detail {
+        //Ownership policies, set the release callback of a new wrapper
+        
+        template<typename T>
+        struct ObjectOwnership<T, LuaOwnership::Lua>
+        {
+            static void Adopt(ObjectHolder<T>* pHolder) { pHolder->pfnRelease = Release; }
+            static void Release(ObjectHolder<T>* pHolder) { delete pHolder->pObj; }
+        };
+        
+        template<typename T>
+        struct ObjectOwnership<T, LuaOwnership::Cpp>
+        {
+            static void Adopt(ObjectHolder<T>* pHolder) { pHolder->pfnRelease = nullptr; }
+        };
+        
+        template<typename T>
+        struct ObjectOwnership<T, LuaOwnership::Shared>
+        {
+            //Shared objects are adopted by LuaClass<T>::Push(lua_State*, std::shared_ptr<T>)
+            static void Release(ObjectHolder<T>* pHolder) { reinterpret_cast<std::shared_ptr<T>*>(&pHolder->SharedStorage)->~shared_ptr(); }
+        };
+        
+        template<typename T>
+        struct ObjectOwnership<T, LuaOwnership::Intrusive>
+        {
+            static void Adopt(ObjectHolder<T>* pHolder)
+            {
+                LuaIntrusiveRefCount<T>::AddRef(pHolder->pObj);
+                pHolder->pfnRelease = Release;
+            }
+            static void Release(ObjectHolder<T>* pHolder) { LuaIntrusiveRefCount<T>::Release(pHolder->pObj); }
+        };
+        
+        //Objects constructed inside their core_ userdata, right behind the holder
+        
+        template<typename T>
+        struct ObjectInPlace
+        {
+            //Room for the holder, padding to align T (userdata is only guaranteed to be aligned for basic types) and T itself
+            static const size_t Size = sizeof(ObjectHolder<T>) + std::alignment_of<T>::value - 1 + sizeof(T);
+            
+            static void* Storage(ObjectHolder<T>* pHolder)
+            {
+                const size_t align = std::alignment_of<T>::value;
+                size_t addr = reinterpret_cast<size_t>(pHolder + 1);
+                return reinterpret_cast<void*>((addr + align - 1) & ~(align - 1));
+            }
+            
+            //Pushes a new holder without object, the caller constructs into Storage() and sets pObj afterwards
+            static ObjectHolder<T>* PushHolder(lua_State* L)
+            {
+                auto pHolder = static_cast<ObjectHolder<T>*>(lua_newuserdata(L, Size));
+                pHolder->pObj = nullptr;
+                pHolder->pfnRelease = Release;
+                pHolder->ExternalSize = 0;
+                return pHolder;
+            }
+            
+            static void Release(ObjectHolder<T>* pHolder) { pHolder->pObj->~T(); }
+        };
+        
+        //Collected wrappers of objects constructed in place, kept for reuse in an array in the registry
+        
+        template<typename T>
+        struct ObjectPool
+        {
+            static unsigned int s_Capacity;
+            static LuaPoolStats s_Stats;
+            
+            static void PushPool(lua_State* L)
+            {
+                lua_rawgetp(L, LUA_REGISTRYINDEX, &s_Capacity);
+                if(lua_istable(L, -1))
+                    return;
+                lua_pop(L, 1);
+                
+                lua_newtable(L);
+                lua_pushvalue(L, -1);
+                lua_rawsetp(L, LUA_REGISTRYINDEX, &s_Capacity);
+            }
+            
+            //Stores a copy of the member entries of the wrapper at wrapperIdx as uservalue of its core_ userdata
+            static void SaveMembers(lua_State* L, int wrapperIdx)
+            {
+                wrapperIdx = lua_absindex(L, wrapperIdx);
+                
+                lua_pushstring(L, "core_");
+                lua_rawget(L, wrapperIdx);
+                lua_newtable(L);
+                
+                lua_pushnil(L);
+                while(lua_next(L, wrapperIdx) != 0){
+                    if(lua_type(L, -2) == LUA_TSTRING && strcmp(lua_tostring(L, -2), "core_") == 0){
+                        lua_pop(L, 1);
+                        continue;
+                    }
+                    lua_pushvalue(L, -2);
+                    lua_insert(L, -2);
+                    lua_rawset(L, -4);
+                }
+                
+                lua_setuservalue(L, -2);
+                lua_pop(L, 1);
+            }
+            
+            //Pops a recycled wrapper and pushes it, returns its holder (destroyed, ready for construction) or nullptr when the pool is empty
+            static ObjectHolder<T>* Acquire(lua_State* L)
+            {
+                if(s_Capacity == 0)
+                    return nullptr;
+                
+                PushPool(L);
+                auto size = static_cast<lua_Integer>(lua_rawlen(L, -1));
+                if(size == 0){
+                    lua_pop(L, 1);
+                    ++s_Stats.Misses;
+                    return nullptr;
+                }
+                
+                lua_rawgeti(L, -1, size);
+                lua_pushnil(L);
+                lua_rawseti(L, -3, size);
+                lua_remove(L, -2); //Remove pool
+                
+                lua_pushstring(L, "core_");
+                lua_rawget(L, -2);
+                auto pHolder = static_cast<ObjectHolder<T>*>(lua_touserdata(L, -1));
+                lua_pop(L, 1);
+                
+                ++s_Stats.Hits;
+                return pHolder;
+            }
+            
+            //Called from __gc after the object has been destroyed, resets the wrapper and adds it to the pool if there is room
+            static void Recycle(lua_State* L, int wrapperIdx, int holderIdx)
+            {
+                if(s_Capacity == 0)
+                    return;
+                
+                int top = lua_gettop(L);
+                
+                PushPool(L);
+                int poolIdx = lua_gettop(L);
+                auto size = static_cast<lua_Integer>(lua_rawlen(L, poolIdx));
+                
+                lua_getuservalue(L, holderIdx);
+                int membersIdx = lua_gettop(L);
+                
+                //Full, or created before pooling was enabled
+                if(size >= static_cast<lua_Integer>(s_Capacity) || !lua_istable(L, membersIdx)){
+                    ++s_Stats.Dropped;
+                    lua_settop(L, top);
+                    return;
+                }
+                
+                //Clear every field the script added (clearing fields during traversal is allowed)
+                lua_pushnil(L);
+                while(lua_next(L, wrapperIdx) != 0){
+                    lua_pop(L, 1);
+                    
+                    if(lua_type(L, -1) == LUA_TSTRING && strcmp(lua_tostring(L, -1), "core_") == 0)
+                        continue;
+                    
+                    lua_pushvalue(L, -1);
+                    lua_rawget(L, membersIdx);
+                    bool isMember = !lua_isnil(L, -1);
+                    lua_pop(L, 1);
+                    
+                    if(!isMember){
+                        lua_pushvalue(L, -1);
+                        lua_pushnil(L);
+                        lua_rawset(L, wrapperIdx);
+                    }
+                }
+                
+                //Restore member entries the script may have overwritten, these keys still exist so nothing is allocated
+                lua_pushnil(L);
+                while(lua_next(L, membersIdx) != 0){
+                    lua_pushvalue(L, -2);
+                    lua_insert(L, -2);
+                    lua_rawset(L, wrapperIdx);
+                }
+                
+                lua_pushvalue(L, wrapperIdx);
+                lua_rawseti(L, poolIdx, size + 1);
+                ++s_Stats.Recycled;
+                
+                lua_settop(L, top);
+            }
+        };
+        
+        template<typename T>
+        unsigned int ObjectPool<T>::s_Capacity = 0;
+        
+        template<typename T>
+        LuaPoolStats ObjectPool<T>::s_Stats = {};
+        
+        //Constructs into a pooled wrapper if there is one, otherwise into a new holder
+        template<typename T, typename Tuple>
+        void PushConstructedInPlace(lua_State* pLuaState, Tuple && tpl)
+        {
+            auto pHolder = ObjectPool<T>::Acquire(pLuaState);
+            if(!pHolder)
+                pHolder = ObjectInPlace<T>::PushHolder(pLuaState);
+            
+            pHolder->pObj = construct<T>(ObjectInPlace<T>::Storage(pHolder), std::forward<Tuple>(tpl));
+        }
+        
+        //n args
+        template<typename T, typename... _ArgTypes>
+        struct InPlaceConstructor
+        {
+            static int execute(lua_State* pLuaState, void* fn, ArgErrorCbType onArgError)
+            {
+                bool isOk = CheckArgCount<_ArgTypes...>(pLuaState, lua_gettop(pLuaState));
+                if(!isOk)
+                    return onArgError(pLuaState, 0);
+                
+                int err = 0;
+                auto tpl = build_tuple_from_lua_stack<_ArgTypes...>::execute(pLuaState, 1, isOk, onArgError, err);
+                if(!isOk)
+                    return err;
+                
+                PushConstructedInPlace<T>(pLuaState, tpl);
+                return 1;
+            }
+        };
+        
+        //0 args
+        template<typename T>
+        struct InPlaceConstructor<T>
+        {
+            static int execute(lua_State* pLuaState, void* fn, ArgErrorCbType onArgError)
+            {
+                if(lua_gettop(pLuaState) != 0) //argc
+                    return onArgError(pLuaState, 0);
+                
+                PushConstructedInPlace<T>(pLuaState, std::tuple<>());
+                return 1;
+            }
+        };
+        
+        //Pointers to bound classes and shared pointers are pushed as object wrappers
+        
+        template<typename T, typename = void>
+        // // True for classes declared with LUACLASS (or providing the same hooks), the only ones LuaClass<T> can wrap
+        struct IsBoundClass : std::false_type {};
+        
+        template<typename T>
+        struct IsBoundClass<T, typename std::enable_if<std::is_same<decltype(&T::RegisterVariables), void(*)(T*)>::value &&
+                                                       std::is_same<decltype(&T::RegisterStaticsAndMethods), void(*)(void)>::value>::type> : std::true_type {};
+        
+        template<typename T>
+        struct Pusher<T*, typename std::enable_if<std::is_class<T>::value && IsBoundClass<T>::value>::type>
+        {
+            static void push(lua_State* pLua, T* data) { LuaClass<T>::template Push<>(pLua, data); }
+        };
+        
+        //Other classes have no wrapper, scripts get an opaque handle they can pass back
+        template<typename T>
+        struct Pusher<T*, typename std::enable_if<std::is_class<T>::value && !IsBoundClass<T>::value>::type>
+        {
+            static void push(lua_State* pLua, T* data) { LuaStack::pushVariable<void*>(pLua, const_cast<void*>(static_cast<const void*>(data))); }
+        };
+        
+        template<typename T>
+        struct Pusher<std::shared_ptr<T>>
+        {
+            static void push(lua_State* pLua, std::shared_ptr<T> data) { LuaClass<T>::Push(pLua, std::move(data)); }
+        };
+    }
+
 	template <typename T>
 	const char* LuaClass<T>::s_ClassName = nullptr;
     
     template <typename T>
     void(*LuaClass<T>::s_fn_inst_reg)(T*) = nullptr;
+    
+    template <typename T>
+    LuaInheritance LuaClass<T>::s_Inheritance = LuaInheritance::Chained;
+    
+    template <typename T>
+    size_t LuaClass<T>::s_ExternalSize = 0;
+    
+    template <typename T>
+    size_t(*LuaClass<T>::s_pfnExternalSize)(const T&) = nullptr;
+    
+    template <typename T>
+    int LuaClass<T>::s_MetricsCounter = detail::Metrics::OtherObjectsWrapped;
 
 	template <typename T>
 	// // Registers Class T in the Lua environment
@@ -61,6 +348,7 @@ namespace LuaLink
     void LuaClass<T>::Register(const char* className, bool bAllowInheritance, void(*fn_static_reg)(void), void(*fn_inst_reg)(void*))
     {
         s_ClassName = className;
+        s_MetricsCounter = detail::Metrics::ClassCounter(className);
         s_fn_inst_reg = reinterpret_cast<void(*)(T*)>(fn_inst_reg);
         
         lua_State* L = LuaScript::GetLuaState();
@@ -92,19 +380,30 @@ namespace LuaLink
         
         T::RegisterStaticsAndMethods();
         
-        LuaStaticMethod<T>::CommitConstructors(L, -3, ConstructorWrapper, ConstructorWrapper);
-        LuaStaticMethod<T>::Commit(L, -3);
-        LuaMethod<T>::Commit(L, -3);
+        LuaStaticMethod<T>::CommitConstructors(L, -3, s_ClassName, ConstructorWrapper, ConstructorWrapper);
+        LuaStaticMethod<T>::Commit(L, -3, s_ClassName);
+        LuaMethod<T>::Commit(L, -3, s_ClassName);
         LuaVariable::Commit(L);
         
+        if(s_Inheritance == LuaInheritance::Flattened)
+            MakeFlattened(L, -1, 0);
+        
         //Set table name (pops table)
         lua_setglobal(L, s_ClassName);
     }
     
+    template<typename T>
+    void LuaClass<T>::SetInheritance(LuaInheritance inheritance)
+    {
+        s_Inheritance = inheritance;
+    }
+    
 	
 	template <typename T>
 	int LuaClass<T>::ConstructorWrapper(lua_State * L)
 	{
+		detail::Metrics::CountBindingCall();
+		detail::Trace::Scope traceScope(L, lua_upvalueindex(3));
 		return ConstructorWrapper(L, 
 							reinterpret_cast<detail::WrapperDoubleArg>(LuaStack::getVariable<void*>( L, lua_upvalueindex(1) ) ),
 							LuaStack::getVariable<void*>( L, lua_upvalueindex(2) ),
@@ -118,25 +417,276 @@ namespace LuaLink
 		if(pWrapper(L, pFunc, onArgError) == -1)
 			return onArgError(L, 0);
 	
-		T*  pObj = static_cast<T*>( LuaStack::getVariable<void*>( L, -1) );
+		//Registered constructor signatures build the object inside the core_ userdata, it only needs a wrapper
+		if(lua_type(L, -1) == LUA_TUSERDATA){
+			detail::Metrics::Increment(s_MetricsCounter);
+			WrapHolder(L);
+		}
+		
+		//... or inside a recycled wrapper taken from the pool
+		else if(lua_type(L, -1) == LUA_TTABLE){
+			detail::Metrics::Increment(s_MetricsCounter);
+			ReviveWrapper(L);
+		}
+		
+		else{
+			T*  pObj = static_cast<T*>( LuaStack::getVariable<void*>( L, -1) );
+		
+			//Objects created from Lua are owned by Lua
+			Push<LuaOwnership::Lua>(L, pObj);
+		}
+		
+		if(s_ExternalSize != 0 || s_pfnExternalSize)
+			CreditExternalSize(L);
 	
+		return 1; //Return 1 value, our new table
+	}
+
+	template <typename T>
+	template <LuaOwnership _Ownership>
+	void LuaClass<T>::Push(lua_State* L, T* pObj)
+	{
+		static_assert(_Ownership != LuaOwnership::Shared, "LuaOwnership::Shared only applies to std::shared_ptr<T>, push a std::shared_ptr or pick another ownership for T*");
+		
+		//Classes registered lazily are built on first use
+		if(!s_ClassName)
+			LuaScript::RegisterPendingClass(static_cast<void(*)(const char*, bool)>(&LuaClass<T>::Register));
+		
+		if(!pObj){
+			lua_pushnil(L);
+			return;
+		}
+		
+		//Without a registered class there is no wrapper to build, the script still gets the address it can pass back
+		if(!s_ClassName){
+			lua_pushlightuserdata(L, pObj);
+			return;
+		}
+		
+		if(PushCached(L, pObj))
+			return;
+		
+		//Shared never gets here (see the static_assert above), mapping it keeps the compiler at that one error
+		detail::ObjectOwnership<T, _Ownership == LuaOwnership::Shared ? LuaOwnership::Cpp : _Ownership>::Adopt(PushNewWrapper(L, pObj));
+	}
+
+	template <typename T>
+	void LuaClass<T>::Push(lua_State* L, std::shared_ptr<T> pObj)
+	{
+		if(!s_ClassName)
+			LuaScript::RegisterPendingClass(static_cast<void(*)(const char*, bool)>(&LuaClass<T>::Register));
+		
+		if(!pObj || !s_ClassName){
+			lua_pushnil(L);
+			return;
+		}
+		
+		if(PushCached(L, pObj.get()))
+			return;
+		
+		detail::ObjectHolder<T>* pHolder = PushNewWrapper(L, pObj.get());
+		new (&pHolder->SharedStorage) std::shared_ptr<T>(std::move(pObj));
+		pHolder->pfnRelease = detail::ObjectOwnership<T, LuaOwnership::Shared>::Release;
+	}
+
+	template <typename T>
+	void LuaClass<T>::Detach(T* pObj)
+	{
+		lua_State* L = LuaScript::GetLuaState();
+		if(!L || !pObj)
+			return;
+		
+		if(!PushCached(L, pObj))
+			return;
+		
+		//Wrapper no longer refers to the object, method calls on it will raise an error
+		lua_pushstring(L, "core_");
+		lua_rawget(L, -2);
+		auto pHolder = static_cast<detail::ObjectHolder<T>*>(lua_touserdata(L, -1));
+		if(pHolder && pHolder->pObj){
+			pHolder->pObj = nullptr;
+			detail::Metrics::Increment(s_MetricsCounter + 1);
+		}
+		lua_pop(L, 2);
+		
+		//Remove it from the cache, so the address can be reused by another object
+		PushIdentityCache(L);
+		lua_pushnil(L);
+		lua_rawsetp(L, -2, pObj);
+		lua_pop(L, 1);
+	}
+
+	template <typename T>
+	bool LuaClass<T>::PushCached(lua_State* L, T* pObj)
+	{
+		PushIdentityCache(L);
+		lua_rawgetp(L, -1, pObj);
+		lua_remove(L, -2); //Remove cache
+		
+		if(lua_istable(L, -1))
+			return true;
+		
+		lua_pop(L, 1);
+		return false;
+	}
+
+	template <typename T>
+	detail::ObjectHolder<T>* LuaClass<T>::PushNewWrapper(lua_State* L, T* pObj)
+	{
+		auto pHolder = static_cast<detail::ObjectHolder<T>*>(lua_newuserdata(L, sizeof(detail::ObjectHolder<T>))); // Push new userdata value
+		pHolder->pObj = pObj; //Userdata should point to our object
+		pHolder->pfnRelease = nullptr; //Borrowed until the caller says otherwise
+		pHolder->ExternalSize = 0;
+		detail::Metrics::Increment(s_MetricsCounter);
+		
+		WrapHolder(L);
+		return pHolder;
+	}
+
+	template <typename T>
+	void LuaClass<T>::WrapHolder(lua_State* L)
+	{
+		auto pHolder = static_cast<detail::ObjectHolder<T>*>(lua_touserdata(L, -1));
+		
+#ifdef LUALINK_USERDATA_GC
+		//Wrapper tables are never finalized, the holder releases the object instead
+		lua_rawgetp(L, LUA_REGISTRYINDEX, &s_HolderMetatableKey);
+		if(!lua_istable(L, -1)){
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_pushstring(L, "__gc");
+			lua_pushcfunction(L, gc_holder);
+			lua_rawset(L, -3);
+			lua_pushvalue(L, -1);
+			lua_rawsetp(L, LUA_REGISTRYINDEX, &s_HolderMetatableKey);
+		}
+		lua_setmetatable(L, -2);
+#endif
+		
 		lua_newtable(L); //Create new table
 
 		//Add core_ entry to the table
-		lua_pushstring(L,"core_");		
-		T** memLoc = static_cast<T**>(lua_newuserdata(L, sizeof(T *))); // Push new userdata value
-		*memLoc = pObj; //Userdata should point to our newly allocated object
+		lua_pushstring(L,"core_");
+		lua_pushvalue(L, -3);
 		lua_settable(L,-3);
+		lua_remove(L, -2); //Remove userdata, the table refers to it from now on
 
 		//Push nonstatic properties
-        T::RegisterVariables(pObj);
+        T::RegisterVariables(pHolder->pObj);
 		LuaVariable::Commit(L,-3);
 
 		//Set the class table as metatable for this object
 		lua_getglobal(L, s_ClassName);
 		lua_setmetatable(L, -2);
-	
-		return 1; //Return 1 value, our new table
+		
+		//Remember the wrapper, so pushing the same object again returns it
+		PushIdentityCache(L);
+		lua_pushvalue(L, -2);
+		lua_rawsetp(L, -2, pHolder->pObj);
+		lua_pop(L, 1);
+		
+		//Pooled objects keep their member entries aside, to restore the wrapper when it is recycled
+		if(detail::ObjectPool<T>::s_Capacity != 0 && pHolder->pfnRelease == detail::ObjectInPlace<T>::Release)
+			detail::ObjectPool<T>::SaveMembers(L, -1);
+	}
+
+	template <typename T>
+	void LuaClass<T>::ReviveWrapper(lua_State* L)
+	{
+		//Setting the metatable again marks the wrapper for finalization again
+		lua_getglobal(L, s_ClassName);
+		lua_setmetatable(L, -2);
+		
+		lua_pushstring(L, "core_");
+		lua_rawget(L, -2);
+		auto pHolder = static_cast<detail::ObjectHolder<T>*>(lua_touserdata(L, -1));
+		lua_pop(L, 1);
+		
+		PushIdentityCache(L);
+		lua_pushvalue(L, -2);
+		lua_rawsetp(L, -2, pHolder->pObj);
+		lua_pop(L, 1);
+	}
+
+	template <typename T>
+	void LuaClass<T>::SetPoolCapacity(unsigned int capacity)
+	{
+#ifndef LUALINK_USERDATA_GC
+		detail::ObjectPool<T>::s_Capacity = capacity;
+#else
+		(void)capacity; //Recycling needs wrapper finalizers
+#endif
+	}
+
+	template <typename T>
+	void LuaClass<T>::SetExternalSize(size_t bytes)
+	{
+		s_ExternalSize = bytes;
+		s_pfnExternalSize = nullptr;
+	}
+
+	template <typename T>
+	void LuaClass<T>::SetExternalSizeCallback(size_t(*pfnSize)(const T&))
+	{
+		s_pfnExternalSize = pfnSize;
+	}
+
+	template <typename T>
+	void LuaClass<T>::CreditExternalSize(lua_State* L)
+	{
+		lua_pushstring(L, "core_");
+		lua_rawget(L, -2);
+		auto pHolder = static_cast<detail::ObjectHolder<T>*>(lua_touserdata(L, -1));
+		lua_pop(L, 1);
+		
+		//Constructors may return an object that already has a wrapper
+		if(!pHolder || !pHolder->pObj || pHolder->ExternalSize != 0)
+			return;
+		
+		pHolder->ExternalSize = s_pfnExternalSize ? s_pfnExternalSize(*pHolder->pObj) : s_ExternalSize;
+		LuaScript::AddExternalMemory(L, pHolder->ExternalSize);
+	}
+
+	template <typename T>
+	void LuaClass<T>::Release(detail::ObjectHolder<T>* pHolder)
+	{
+		if(pHolder->pfnRelease)
+			pHolder->pfnRelease(pHolder);
+		pHolder->pObj = nullptr;
+		detail::Metrics::Increment(s_MetricsCounter + 1);
+		
+		if(pHolder->ExternalSize != 0){
+			LuaScript::RemoveExternalMemory(pHolder->ExternalSize);
+			pHolder->ExternalSize = 0;
+		}
+	}
+
+	template <typename T>
+	const LuaPoolStats& LuaClass<T>::GetPoolStats(void)
+	{
+		return detail::ObjectPool<T>::s_Stats;
+	}
+
+	template <typename T>
+	void LuaClass<T>::PushIdentityCache(lua_State* L)
+	{
+		//The cache is stored in the registry, keyed by an address that is unique to this class
+		lua_rawgetp(L, LUA_REGISTRYINDEX, &s_ClassName);
+		if(lua_istable(L, -1))
+			return;
+		lua_pop(L, 1);
+		
+		lua_newtable(L);
+		
+		//Weak values, the cache must not keep wrappers alive
+		lua_newtable(L);
+		lua_pushstring(L, "__mode");
+		lua_pushstring(L, "v");
+		lua_settable(L, -3);
+		lua_setmetatable(L, -2);
+		
+		lua_pushvalue(L, -1);
+		lua_rawsetp(L, LUA_REGISTRYINDEX, &s_ClassName);
 	}
 
 	template <typename T>
@@ -146,15 +696,34 @@ namespace LuaLink
 		//Retrieve C++ object
 		lua_pushstring(L, "core_");
 		lua_rawget(L, 1);
-		T** ppObj = static_cast < T ** >(lua_touserdata(L, -1));
+		auto pHolder = static_cast<detail::ObjectHolder<T>*>(lua_touserdata(L, -1));
 		
-		//Delete object
-		if(ppObj)
-			delete *ppObj;
+		//Release object according to its ownership
+		if(pHolder && pHolder->pObj)
+			Release(pHolder);
+		
+		//Keep wrappers of objects constructed in place, their storage can be reused by the next construction
+		if(pHolder && pHolder->pfnRelease == detail::ObjectInPlace<T>::Release)
+			detail::ObjectPool<T>::Recycle(L, 1, 2);
 		
 		return 0; //No return value
 	}	
 
+#ifdef LUALINK_USERDATA_GC
+	template <typename T>
+	//Metamethod of the holder, called when garbage collector gets rid of our object
+	int LuaClass<T>::gc_holder(lua_State* L)
+	{
+		auto pHolder = static_cast<detail::ObjectHolder<T>*>(lua_touserdata(L, 1));
+		if(pHolder && pHolder->pObj)
+			Release(pHolder);
+		return 0;
+	}
+
+	template <typename T>
+	char LuaClass<T>::s_HolderMetatableKey = 0;
+#endif
+
 	template <typename T>
 	//Metamethod, called when converting our object to a string
 	int LuaClass<T>::to_string(lua_State* L)
@@ -174,6 +743,9 @@ namespace LuaLink
 	template<typename T>
 	int LuaClass<T>::returnDerived(lua_State* L)
 	{
+		if(s_Inheritance == LuaInheritance::Flattened)
+			return returnFlattenedDerived(L);
+		
 		//Create new empty table
 		lua_newtable(L);
 	
@@ -199,6 +771,244 @@ namespace LuaLink
 		return 1;
 	}
 
+	//Flattened inheritance
+	//
+	// Every class table ("front") only holds metamethods, its __index is a "view" table that contains the class's own
+	// members plus every inherited member that has been looked up before. Misses in the view are resolved in the view
+	// of the base class and cached, so lookups cost the same at any depth. Assignments to a front are caught by
+	// __newindex (the front never holds them), stored in "own" and evicted from the views of all descendants.
+	// The bookkeeping lives in the front's metatable: { own, view, base, children, __index = view, __newindex }
+
+	template<typename T>
+	int LuaClass<T>::returnFlattenedDerived(lua_State* L)
+	{
+		//Base:inherit() derives from Base, Class.inherit() derives from the C++ class
+		int baseMeta = 0;
+		if(lua_istable(L, 1) && lua_getmetatable(L, 1)){
+			lua_pushstring(L, "view");
+			lua_rawget(L, -2);
+			bool isFlattened = lua_istable(L, -1);
+			lua_pop(L, 1);
+			
+			if(isFlattened)
+				baseMeta = lua_gettop(L);
+			else
+				lua_pop(L, 1);
+		}
+		
+		if(baseMeta == 0){
+			lua_getglobal(L, s_ClassName);
+			if(!lua_getmetatable(L, -1))
+				return luaL_error(L, "%s does not use flattened inheritance", s_ClassName);
+			baseMeta = lua_gettop(L);
+		}
+		
+		//Create new table, metamethods are the only fields a front holds itself
+		lua_newtable(L);
+		
+		lua_pushstring(L,"__gc");
+		lua_pushcfunction(L, gc_obj);
+		lua_rawset(L,-3);
+		
+		lua_pushstring(L, "__tostring");
+		lua_pushcfunction(L, to_string);
+		lua_rawset(L, -3);
+		
+		MakeFlattened(L, -1, baseMeta);
+		return 1;
+	}
+
+	template<typename T>
+	void LuaClass<T>::MakeFlattened(lua_State* L, int frontIdx, int baseMetaIdx)
+	{
+		frontIdx = lua_absindex(L, frontIdx);
+		
+		lua_newtable(L); //metatable
+		int meta = lua_gettop(L);
+		
+		lua_newtable(L); //own
+		int own = lua_gettop(L);
+		
+		lua_newtable(L); //view
+		int view = lua_gettop(L);
+		
+		//Move members committed by Register from the front to own and view
+		lua_pushnil(L);
+		while(lua_next(L, frontIdx) != 0){
+			const char* key = lua_type(L, -2) == LUA_TSTRING ? lua_tostring(L, -2) : nullptr;
+			if(key && key[0] == '_' && key[1] == '_'){
+				lua_pop(L, 1);
+				continue;
+			}
+			
+			lua_pushvalue(L, -2);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, own);
+			lua_pushvalue(L, -2);
+			lua_insert(L, -2);
+			lua_rawset(L, view);
+			
+			//Clearing fields during traversal is allowed
+			lua_pushvalue(L, -1);
+			lua_pushnil(L);
+			lua_rawset(L, frontIdx);
+		}
+		
+		//Misses in the view are resolved in the base class
+		lua_newtable(L);
+		lua_pushstring(L, "__index");
+		lua_pushvalue(L, meta);
+		lua_pushcclosure(L, flattenedResolve, 1);
+		lua_rawset(L, -3);
+		lua_setmetatable(L, view);
+		
+		lua_pushstring(L, "own");
+		lua_pushvalue(L, own);
+		lua_rawset(L, meta);
+		
+		lua_pushstring(L, "view");
+		lua_pushvalue(L, view);
+		lua_rawset(L, meta);
+		
+		//Descendants, weak keys so derived classes can still be collected
+		lua_pushstring(L, "children");
+		lua_newtable(L);
+		lua_newtable(L);
+		lua_pushstring(L, "__mode");
+		lua_pushstring(L, "k");
+		lua_rawset(L, -3);
+		lua_setmetatable(L, -2);
+		lua_rawset(L, meta);
+		
+		if(baseMetaIdx != 0){
+			lua_pushstring(L, "base");
+			lua_pushvalue(L, baseMetaIdx);
+			lua_rawset(L, meta);
+			
+			lua_pushstring(L, "children");
+			lua_rawget(L, baseMetaIdx);
+			lua_pushvalue(L, meta);
+			lua_pushboolean(L, 1);
+			lua_rawset(L, -3);
+			lua_pop(L, 1);
+		}
+		
+		//Lookups on the class table itself (Class.new) go to the view as well
+		lua_pushstring(L, "__index");
+		lua_pushvalue(L, view);
+		lua_rawset(L, meta);
+		
+		lua_pushstring(L, "__newindex");
+		lua_pushvalue(L, meta);
+		lua_pushcclosure(L, flattenedNewIndex, 1);
+		lua_rawset(L, meta);
+		
+		//Instances look up members in the view
+		lua_pushstring(L, "__index");
+		lua_pushvalue(L, view);
+		lua_rawset(L, frontIdx);
+		
+		lua_pushvalue(L, meta);
+		lua_setmetatable(L, frontIdx);
+		
+		lua_settop(L, meta - 1);
+	}
+
+	template<typename T>
+	int LuaClass<T>::flattenedResolve(lua_State* L)
+	{
+		//1 = view, 2 = key
+		lua_pushstring(L, "base");
+		lua_rawget(L, lua_upvalueindex(1));
+		if(!lua_istable(L, -1))
+			return 0;
+		
+		//Look up in the base view, which resolves and caches along the way
+		lua_pushstring(L, "view");
+		lua_rawget(L, -2);
+		lua_pushvalue(L, 2);
+		lua_gettable(L, -2);
+		
+		if(!lua_isnil(L, -1)){
+			lua_pushvalue(L, 2);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, 1);
+		}
+		
+		return 1;
+	}
+
+	template<typename T>
+	int LuaClass<T>::flattenedNewIndex(lua_State* L)
+	{
+		//1 = front, 2 = key, 3 = value
+		int meta = lua_upvalueindex(1);
+		
+		lua_pushstring(L, "own");
+		lua_rawget(L, meta);
+		lua_pushvalue(L, 2);
+		lua_pushvalue(L, 3);
+		lua_rawset(L, -3);
+		
+		lua_pushstring(L, "view");
+		lua_rawget(L, meta);
+		lua_pushvalue(L, 2);
+		lua_pushvalue(L, 3);
+		lua_rawset(L, -3);
+		
+		//Metamethods have to be fields of the front to take effect
+		if(lua_type(L, 2) == LUA_TSTRING){
+			const char* key = lua_tostring(L, 2);
+			if(key[0] == '_' && key[1] == '_' && strcmp(key, "__index") != 0){
+				lua_pushvalue(L, 2);
+				lua_pushvalue(L, 3);
+				lua_rawset(L, 1);
+			}
+		}
+		
+		lua_settop(L, 3);
+		lua_pushvalue(L, meta);
+		EvictFromDescendants(L, 4, 2);
+		return 0;
+	}
+
+	template<typename T>
+	void LuaClass<T>::EvictFromDescendants(lua_State* L, int metaIdx, int keyIdx)
+	{
+		luaL_checkstack(L, 8, "class hierarchy too deep");
+		
+		lua_pushstring(L, "children");
+		lua_rawget(L, metaIdx);
+		
+		lua_pushnil(L);
+		while(lua_next(L, -2) != 0){
+			lua_pop(L, 1);
+			int child = lua_gettop(L);
+			
+			//A descendant that defines the key itself hides the change from its own descendants
+			lua_pushstring(L, "own");
+			lua_rawget(L, child);
+			lua_pushvalue(L, keyIdx);
+			lua_rawget(L, -2);
+			bool isOwn = !lua_isnil(L, -1);
+			lua_pop(L, 2);
+			
+			if(isOwn)
+				continue;
+			
+			lua_pushstring(L, "view");
+			lua_rawget(L, child);
+			lua_pushvalue(L, keyIdx);
+			lua_pushnil(L);
+			lua_rawset(L, -3);
+			lua_pop(L, 1);
+			
+			EvictFromDescendants(L, child, keyIdx);
+		}
+		
+		lua_pop(L, 1);
+	}
+
 	template<typename T>
 	int LuaClass<T>::noInheritance(lua_State* L)
 	{
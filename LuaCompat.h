@@ -0,0 +1,54 @@
+//
+//  LuaCompat.h
+//  LuaLink
+//
+//  Includes Lua and fills in the parts of the Lua 5.2 API LuaLink uses when
+//  building against LuaJIT 2.1 (Lua 5.1 API).
+//
+
+#pragma once
+
+#include <lua.hpp>
+
+#if LUA_VERSION_NUM < 502
+
+#ifndef LUAJIT_VERSION
+#error "LuaLink requires Lua 5.2 or newer, or LuaJIT 2.1"
+#endif
+
+//Table finalizers (__gc on the wrapper table) only run from Lua 5.2 on, LuaClass finalizes the object holder instead
+#define LUALINK_USERDATA_GC
+
+typedef size_t lua_Unsigned;
+
+inline int lua_absindex(lua_State* L, int idx)
+{
+    return (idx > 0 || idx <= LUA_REGISTRYINDEX) ? idx : lua_gettop(L) + idx + 1;
+}
+
+inline void lua_rawgetp(lua_State* L, int idx, const void* p)
+{
+    idx = lua_absindex(L, idx);
+    lua_pushlightuserdata(L, const_cast<void*>(p));
+    lua_rawget(L, idx);
+}
+
+inline void lua_rawsetp(lua_State* L, int idx, const void* p)
+{
+    idx = lua_absindex(L, idx);
+    lua_pushlightuserdata(L, const_cast<void*>(p));
+    lua_insert(L, -2);
+    lua_rawset(L, idx);
+}
+
+#ifndef lua_pushglobaltable
+inline void lua_pushglobaltable(lua_State* L) { lua_pushvalue(L, LUA_GLOBALSINDEX); }
+#endif
+
+inline size_t lua_rawlen(lua_State* L, int idx) { return lua_objlen(L, idx); }
+
+//Userdata environments serve as uservalues, they have to be tables
+inline void lua_getuservalue(lua_State* L, int idx) { lua_getfenv(L, idx); }
+inline void lua_setuservalue(lua_State* L, int idx) { lua_setfenv(L, idx); }
+
+#endif
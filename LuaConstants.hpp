@@ -0,0 +1,109 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include "LuaCompat.h"
+#include "LuaStack.hpp"
+#include <string>
+#include <type_traits>
+
+namespace LuaLink
+{
+	namespace detail {
+		namespace LuaConstants {
+			//Stores a constant until it is committed
+			struct Constant
+			{
+				enum Kind { Integer, Number, String };
+
+				Constant(const char* name, lua_Integer value) : Name(name), Type(Integer), IntegerValue(value), NumberValue(0) {}
+				Constant(const char* name, lua_Number value) : Name(name), Type(Number), IntegerValue(0), NumberValue(value) {}
+				Constant(const char* name, std::string value) : Name(name), Type(String), IntegerValue(0), NumberValue(0), StringValue(std::move(value)) {}
+
+				const char* Name;
+				Kind Type;
+				lua_Integer IntegerValue;
+				lua_Number NumberValue;
+				std::string StringValue;
+			};
+
+			template<typename T>
+			typename std::enable_if<IsInteger<T>::value || std::is_enum<T>::value, Constant>::type ToConstant(const char* name, T value) { return Constant(name, static_cast<lua_Integer>(value)); }
+
+			template<typename T>
+			typename std::enable_if<std::is_floating_point<T>::value, Constant>::type ToConstant(const char* name, T value) { return Constant(name, static_cast<lua_Number>(value)); }
+
+			inline Constant ToConstant(const char* name, const char* value) { return Constant(name, std::string(value)); }
+			inline Constant ToConstant(const char* name, const std::string& value) { return Constant(name, value); }
+		}
+	}
+
+	enum class LuaConstantsMode
+	{
+		Plain, //A regular table, scripts can change or add entries
+		Frozen //Reads go through an empty proxy's __index table, assignments raise an error
+	};
+
+	// // Tables of named constants (enum values, flags, error codes) built in one go when the script is initialized:
+	// //     EventId.Spawn reads a plain table entry, EventId(value) returns the name of a value (or nil)
+	class LuaConstants
+	{
+	public:
+		template<typename T>
+		// // Adds a constant (integer, floating point, enum or string) to the global table tableName, replacing one with the same name
+		static void Register(const char* tableName, const char* name, T value);
+
+		// // Plain by default
+		static void SetMode(const char* tableName, LuaConstantsMode mode);
+
+	private:
+		friend class LuaScript;
+
+		static void Register_Impl(const char* tableName, detail::LuaConstants::Constant&& constant);
+
+		// // Creates the global tables of all registered constants
+		static void Commit(lua_State* L);
+
+		//Lua callbacks
+		static int NameOf(lua_State* L); //__call, reverse table as upvalue
+		static int Next(lua_State* L); //Iterator over the constants of a frozen table
+		static int Pairs(lua_State* L); //__pairs of frozen tables, returns Next
+		static int ReadOnly(lua_State* L); //__newindex of frozen tables
+
+		//Disable default constructor, destructor, copy constructor & assignment operator
+		LuaConstants(void) = delete;
+		~LuaConstants(void) = delete;
+		LuaConstants(const LuaConstants& src) = delete;
+		LuaConstants& operator=(const LuaConstants& src) = delete;
+	};
+
+	namespace detail {
+		// // Name of a constant without its scope, "EventId::Spawn" -> "Spawn"
+		inline const char* UnqualifiedName(const char* name)
+		{
+			const char* unqualified = name;
+			for(const char* c = name; *c; ++c)
+				if(c[0] == ':' && c[1] == ':')
+					unqualified = c + 2;
+			return unqualified;
+		}
+	}
+}
+
+#include "LuaConstants.inl"
@@ -0,0 +1,196 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+
+namespace LuaLink
+{
+	template<typename T>
+	void LuaConstants::Register(const char* tableName, const char* name, T value)
+	{
+		Register_Impl(tableName, detail::LuaConstants::ToConstant(name, value));
+	}
+}
+
+#ifdef LUALINK_DEFINE
+
+#include <cstring>
+#include <vector>
+
+namespace LuaLink
+{
+	namespace detail {
+		namespace LuaConstants {
+			struct Table
+			{
+				const char* Name;
+				LuaConstantsMode Mode;
+				std::vector<Constant> Constants;
+			};
+
+			//Temporary container for tables that haven't been commited yet
+			std::vector<Table>& TablesToCommit() {
+				static std::vector<Table> s;
+				return s;
+			}
+
+			Table& FindTable(const char* tableName)
+			{
+				for(auto& table : TablesToCommit())
+					if(strcmp(table.Name, tableName) == 0)
+						return table;
+
+				Table table = { tableName, LuaConstantsMode::Plain, std::vector<Constant>() };
+				TablesToCommit().push_back(std::move(table));
+				return TablesToCommit().back();
+			}
+		}
+	}
+
+	void LuaConstants::Register_Impl(const char* tableName, detail::LuaConstants::Constant&& constant)
+	{
+		auto& constants = detail::LuaConstants::FindTable(tableName).Constants;
+		for(auto& existing : constants){
+			if(strcmp(existing.Name, constant.Name) == 0){
+				existing = std::move(constant);
+				return;
+			}
+		}
+		constants.push_back(std::move(constant));
+	}
+
+	void LuaConstants::SetMode(const char* tableName, LuaConstantsMode mode)
+	{
+		detail::LuaConstants::FindTable(tableName).Mode = mode;
+	}
+
+	void LuaConstants::Commit(lua_State* L)
+	{
+		using detail::LuaConstants::Constant;
+		
+		for(auto& table : detail::LuaConstants::TablesToCommit())
+		{
+			int nrOfConstants = static_cast<int>(table.Constants.size());
+
+			//Constants and reverse lookup, both presized and filled without metamethods
+			lua_createtable(L, 0, nrOfConstants);
+			int values = lua_gettop(L);
+			lua_createtable(L, 0, nrOfConstants);
+			int names = lua_gettop(L);
+
+			for(auto& constant : table.Constants){
+				lua_pushstring(L, constant.Name);
+				switch(constant.Type)
+				{
+					case Constant::Integer:
+						lua_pushinteger(L, constant.IntegerValue);
+						break;
+					case Constant::Number:
+						lua_pushnumber(L, constant.NumberValue);
+						break;
+					default:
+						lua_pushlstring(L, constant.StringValue.c_str(), constant.StringValue.size());
+						break;
+				}
+
+				//Aliases share a value, the name registered first is the one looked up (NaN can't be a key)
+				lua_pushvalue(L, -1);
+				lua_rawget(L, names);
+				bool isAlias = !lua_isnil(L, -1) || constant.NumberValue != constant.NumberValue;
+				lua_pop(L, 1);
+				if(!isAlias){
+					lua_pushvalue(L, -1);
+					lua_pushvalue(L, -3);
+					lua_rawset(L, names);
+				}
+
+				lua_rawset(L, values);
+			}
+
+			bool isFrozen = table.Mode == LuaConstantsMode::Frozen;
+			lua_createtable(L, 0, isFrozen ? 5 : 1);
+
+			lua_pushvalue(L, names);
+			lua_pushcclosure(L, NameOf, 1);
+			lua_setfield(L, -2, "__call");
+
+			if(isFrozen){
+				lua_pushvalue(L, values);
+				lua_setfield(L, -2, "__index");
+
+				lua_pushstring(L, table.Name);
+				lua_pushcclosure(L, ReadOnly, 1);
+				lua_setfield(L, -2, "__newindex");
+
+				//Lua 5.2 and up, LuaJIT can't iterate a frozen table
+				lua_pushvalue(L, values);
+				lua_pushcclosure(L, Next, 1);
+				lua_pushcclosure(L, Pairs, 1);
+				lua_setfield(L, -2, "__pairs");
+
+				//getmetatable returns this instead, setmetatable fails
+				lua_pushboolean(L, 0);
+				lua_setfield(L, -2, "__metatable");
+
+				lua_newtable(L); //Proxy
+				lua_insert(L, -2);
+			}
+			else{
+				lua_pushvalue(L, values);
+				lua_insert(L, -2);
+			}
+
+			lua_setmetatable(L, -2);
+			lua_setglobal(L, table.Name);
+			lua_settop(L, values - 1);
+		}
+
+		//Flush the cache of constants to commit so this can be re-used
+		detail::LuaConstants::TablesToCommit().clear();
+	}
+
+	int LuaConstants::NameOf(lua_State* L)
+	{
+		lua_settop(L, 2);
+		lua_rawget(L, lua_upvalueindex(1));
+		return 1;
+	}
+
+	int LuaConstants::Next(lua_State* L)
+	{
+		lua_settop(L, 2);
+		if(lua_next(L, lua_upvalueindex(1)))
+			return 2;
+
+		lua_pushnil(L);
+		return 1;
+	}
+
+	int LuaConstants::Pairs(lua_State* L)
+	{
+		lua_pushvalue(L, lua_upvalueindex(1));
+		lua_pushnil(L);
+		lua_pushnil(L);
+		return 3;
+	}
+
+	int LuaConstants::ReadOnly(lua_State* L)
+	{
+		return luaL_error(L, "%s is read-only", lua_tostring(L, lua_upvalueindex(1)));
+	}
+}
+
+#endif
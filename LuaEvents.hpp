@@ -0,0 +1,145 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "LuaCompat.h"
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace LuaLink
+{
+	namespace detail {
+		struct QueuedEvent;
+
+		//Operations on the arguments of an event, one static instance per argument list
+		struct EventArgOps
+		{
+			int(*Push)(lua_State*, void*); //Pushes the arguments, returns how many were pushed
+			void(*Destroy)(void*);
+			void(*Relocate)(void* pDst, void* pSrc); //Moves inline arguments to another event and destroys the source
+			bool IsInline;
+		};
+
+		//Queued event, arguments are type-erased to keep the queue a single vector
+		//Small arguments live in the event itself, so enqueueing doesn't allocate once the queue has grown
+		struct QueuedEvent
+		{
+			static const size_t InlineSize = 48;
+
+			QueuedEvent(void) : Id(0), Seq(0), pArgs(nullptr), pOps(nullptr) {}
+			QueuedEvent(QueuedEvent&& src) : pArgs(nullptr), pOps(nullptr) { *this = std::move(src); }
+			~QueuedEvent(void) { Reset(); }
+
+			QueuedEvent& operator=(QueuedEvent&& src)
+			{
+				if(this == &src)
+					return *this;
+
+				Reset();
+				Id = src.Id;
+				Seq = src.Seq;
+				pOps = src.pOps;
+				pArgs = src.pArgs;
+				if(pOps && pOps->IsInline){
+					pArgs = &Storage;
+					pOps->Relocate(pArgs, src.pArgs);
+				}
+				src.pArgs = nullptr;
+				src.pOps = nullptr;
+				return *this;
+			}
+
+			int Push(lua_State* L) const { return pOps ? pOps->Push(L, pArgs) : 0; }
+
+			void Reset(void)
+			{
+				if(pOps)
+					pOps->Destroy(pArgs);
+				pArgs = nullptr;
+				pOps = nullptr;
+			}
+
+			int Id;
+			unsigned long long Seq; //Order the event was enqueued in, across threads
+			void* pArgs; //Points to Storage or to the heap, nullptr for events without arguments
+			const EventArgOps* pOps;
+			std::aligned_storage<InlineSize, std::alignment_of<std::max_align_t>::value>::type Storage;
+
+		private:
+			QueuedEvent(const QueuedEvent&) = delete;
+			QueuedEvent& operator=(const QueuedEvent&) = delete;
+		};
+	}
+
+	// // Event bus between C++ and Lua, scripts subscribe handlers by integer event id:
+	// //     Events.Subscribe(id, fn) / Events.Unsubscribe(id, fn)
+	// // C++ queues events from any thread, LuaScript::DispatchEvents delivers the whole queue in a single protected call
+	class LuaEvents
+	{
+	public:
+		template<typename... _ArgTypes>
+		// // Queues an event, its handlers are called with the arguments on the next dispatch (thread-safe)
+		// // Arguments are copied, const char* is copied into a std::string
+		// // Only the calling thread's queue is locked, small arguments are stored without allocating
+		static void Enqueue(int eventId, _ArgTypes... args);
+
+		// // Number of events waiting for the next dispatch (thread-safe)
+		static size_t GetQueueSize(void);
+
+		// // Drops all queued events without delivering them (thread-safe)
+		static void ClearQueue(void);
+
+	private:
+		friend class LuaScript;
+
+		static void Enqueue_Impl(detail::QueuedEvent&& e);
+
+		// // Creates the Events table and the handler registry in a new state
+		static void Commit(lua_State* L);
+
+		// // Moves the queue into the batch that is about to be dispatched, returns false if there is nothing to deliver
+		// // or if a dispatch is already running (DispatchEvents called from a handler)
+		static bool BeginDispatch(void);
+
+		// // Releases delivered events, events after the one that raised an error are queued again
+		static void EndDispatch(bool hasFailed);
+
+		// // Runs inside the protected call, delivers the batch using the handler registry
+		static int DispatchBatch(lua_State* L);
+
+		//Lua callbacks
+		static int Subscribe(lua_State* L);
+		static int Unsubscribe(lua_State* L);
+
+		//Disable default constructor, destructor, copy constructor & assignment operator
+		LuaEvents(void) = delete;
+		~LuaEvents(void) = delete;
+		LuaEvents(const LuaEvents& src) = delete;
+		LuaEvents& operator=(const LuaEvents& src) = delete;
+	};
+
+	namespace detail {
+		template<typename T> struct EventArg;
+		template<typename... T> struct EventArgs;
+	}
+}
+
+#include "LuaEvents.inl"
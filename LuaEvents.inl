@@ -0,0 +1,404 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "LuaStack.hpp"
+#include <new>
+
+namespace LuaLink
+{
+	namespace detail {
+		template<typename T>
+		//Type an argument is stored as until the event is dispatched
+		struct EventArg
+		{
+			typedef typename std::decay<T>::type type;
+		};
+
+		template<>
+		struct EventArg<const char*>
+		{
+			typedef std::string type;
+		};
+
+		template<>
+		struct EventArg<char*>
+		{
+			typedef std::string type;
+		};
+
+		template<typename... T>
+		struct EventArgs
+		{
+			typedef std::tuple<typename EventArg<T>::type...> tuple_type;
+
+			//Stored in the event unless too big or throwing on move, the event has to be able to relocate it
+			static const bool is_inline = sizeof(tuple_type) <= QueuedEvent::InlineSize
+				&& std::alignment_of<tuple_type>::value <= std::alignment_of<std::max_align_t>::value
+				&& std::is_nothrow_move_constructible<tuple_type>::value;
+
+			static int push(lua_State* L, void* pArgs)
+			{
+				Results<tuple_type>::push(L, *static_cast<tuple_type*>(pArgs));
+				return ResultCount<tuple_type>::value;
+			}
+
+			static void destroy(void* pArgs)
+			{
+				if(is_inline)
+					static_cast<tuple_type*>(pArgs)->~tuple_type();
+				else
+					delete static_cast<tuple_type*>(pArgs);
+			}
+
+			static void relocate(void* pDst, void* pSrc)
+			{
+				new(pDst) tuple_type(std::move(*static_cast<tuple_type*>(pSrc)));
+				static_cast<tuple_type*>(pSrc)->~tuple_type();
+			}
+
+			template<typename... _ArgTypes>
+			static void construct(QueuedEvent& e, _ArgTypes&&... args)
+			{
+				e.pArgs = allocate(e, std::integral_constant<bool, is_inline>(), std::forward<_ArgTypes>(args)...);
+				e.pOps = &ops;
+			}
+
+			template<typename... _ArgTypes>
+			static void* allocate(QueuedEvent& e, std::true_type, _ArgTypes&&... args) { return new(&e.Storage) tuple_type(std::forward<_ArgTypes>(args)...); }
+
+			template<typename... _ArgTypes>
+			static void* allocate(QueuedEvent&, std::false_type, _ArgTypes&&... args) { return new tuple_type(std::forward<_ArgTypes>(args)...); }
+
+			static const EventArgOps ops;
+		};
+
+		template<typename... T>
+		const EventArgOps EventArgs<T...>::ops = { EventArgs<T...>::push, EventArgs<T...>::destroy, EventArgs<T...>::relocate, EventArgs<T...>::is_inline };
+	}
+
+	template<typename... _ArgTypes>
+	void LuaEvents::Enqueue(int eventId, _ArgTypes... args)
+	{
+		typedef detail::EventArgs<_ArgTypes...> args_type;
+
+		detail::QueuedEvent e;
+		e.Id = eventId;
+		if(sizeof...(_ArgTypes) > 0)
+			args_type::construct(e, std::move(args)...);
+
+		Enqueue_Impl(std::move(e));
+	}
+}
+
+#ifdef LUALINK_DEFINE
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+namespace LuaLink {
+	namespace detail {
+		namespace LuaEvents {
+			//Events enqueued by one thread, its lock is only contended while a dispatch collects the queue
+			struct ThreadQueue
+			{
+				ThreadQueue(void) : IsExited(false) {}
+
+				std::mutex Mutex;
+				std::vector<QueuedEvent> Events; //Keeps its capacity between dispatches
+				bool IsExited; //Set under the registry lock, the queue is freed once a dispatch has emptied it
+			};
+
+			struct Registry
+			{
+				Registry(void) : NextSeq(0) { Threads.push_back(&Shared); }
+
+				std::mutex Mutex; //Guards Threads, taken once per thread and by dispatches
+				std::vector<ThreadQueue*> Threads;
+				ThreadQueue Shared; //Used by exiting threads, and for events queued again after a failed dispatch
+				std::atomic<unsigned long long> NextSeq;
+			};
+
+			//Never destroyed, events may still be enqueued during static destruction
+			static Registry& GetRegistry(void)
+			{
+				static Registry* s_pRegistry = new Registry();
+				return *s_pRegistry;
+			}
+
+			//Leaves the events of a thread that exits to the next dispatch
+			struct ExitedQueue
+			{
+				ThreadQueue** ppQueue;
+
+				~ExitedQueue(void)
+				{
+					auto& registry = GetRegistry();
+					std::lock_guard<std::mutex> lock(registry.Mutex);
+					(*ppQueue)->IsExited = true;
+					*ppQueue = &registry.Shared;
+				}
+			};
+
+			static ThreadQueue& Local(void)
+			{
+				thread_local ThreadQueue* s_pQueue = nullptr;
+				if(!s_pQueue){
+					s_pQueue = new ThreadQueue();
+					{
+						auto& registry = GetRegistry();
+						std::lock_guard<std::mutex> lock(registry.Mutex);
+						registry.Threads.push_back(s_pQueue);
+					}
+
+					thread_local ExitedQueue s_Exited = { &s_pQueue };
+					(void)s_Exited;
+				}
+				return *s_pQueue;
+			}
+
+			//Moves the events of every thread to the end of events, returns true if they came from more than one queue
+			//Caller holds the registry lock
+			static bool CollectQueues(Registry& registry, std::vector<QueuedEvent>& events)
+			{
+				int nrOfQueues = 0;
+				for(size_t i = 0; i < registry.Threads.size();)
+				{
+					ThreadQueue* pQueue = registry.Threads[i];
+					{
+						std::lock_guard<std::mutex> lock(pQueue->Mutex);
+						if(!pQueue->Events.empty()){
+							++nrOfQueues;
+							events.insert(events.end(), std::make_move_iterator(pQueue->Events.begin()), std::make_move_iterator(pQueue->Events.end()));
+							pQueue->Events.clear();
+						}
+					}
+
+					//Exited threads don't enqueue anymore
+					if(pQueue->IsExited){
+						delete pQueue;
+						registry.Threads.erase(registry.Threads.begin() + i);
+					}
+					else
+						++i;
+				}
+				return nrOfQueues > 1;
+			}
+
+			//Events being dispatched, only touched by the thread that dispatches, keeps its capacity between frames
+			std::vector<QueuedEvent>& Batch() {
+				static std::vector<QueuedEvent> s;
+				return s;
+			}
+
+			//Index in the batch of the event being delivered
+			static size_t s_Cursor = 0;
+
+			//Set between BeginDispatch and EndDispatch, a handler that dispatches again would reuse the batch being delivered
+			static bool s_IsDispatching = false;
+
+			//Registry key of the table mapping event ids to arrays of handlers
+			static char s_HandlersKey;
+		}
+	}
+
+	void LuaEvents::Enqueue_Impl(detail::QueuedEvent&& e)
+	{
+		using namespace detail::LuaEvents;
+
+		auto& queue = Local();
+		e.Seq = GetRegistry().NextSeq.fetch_add(1, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		queue.Events.push_back(std::move(e));
+	}
+
+	size_t LuaEvents::GetQueueSize(void)
+	{
+		using namespace detail::LuaEvents;
+
+		auto& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.Mutex);
+
+		size_t size = 0;
+		for(auto pQueue : registry.Threads){
+			std::lock_guard<std::mutex> queueLock(pQueue->Mutex);
+			size += pQueue->Events.size();
+		}
+		return size;
+	}
+
+	void LuaEvents::ClearQueue(void)
+	{
+		using namespace detail::LuaEvents;
+
+		//Destroyed outside of the locks
+		std::vector<detail::QueuedEvent> dropped;
+		{
+			auto& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.Mutex);
+			CollectQueues(registry, dropped);
+		}
+	}
+
+	void LuaEvents::Commit(lua_State* L)
+	{
+		lua_newtable(L);
+		lua_rawsetp(L, LUA_REGISTRYINDEX, &detail::LuaEvents::s_HandlersKey);
+
+		lua_createtable(L, 0, 2);
+		lua_pushcfunction(L, Subscribe);
+		lua_setfield(L, -2, "Subscribe");
+		lua_pushcfunction(L, Unsubscribe);
+		lua_setfield(L, -2, "Unsubscribe");
+		lua_setglobal(L, "Events");
+	}
+
+	bool LuaEvents::BeginDispatch(void)
+	{
+		using namespace detail::LuaEvents;
+
+		if(s_IsDispatching)
+			return false;
+
+		auto& batch = Batch();
+		bool isInterleaved;
+		{
+			auto& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.Mutex);
+			isInterleaved = CollectQueues(registry, batch);
+		}
+
+		//Each queue is in order already, only events from several threads need to be merged
+		if(isInterleaved)
+			std::sort(batch.begin(), batch.end(), [](const detail::QueuedEvent& a, const detail::QueuedEvent& b) { return a.Seq < b.Seq; });
+
+		s_Cursor = 0;
+		s_IsDispatching = !batch.empty();
+		return s_IsDispatching;
+	}
+
+	void LuaEvents::EndDispatch(bool hasFailed)
+	{
+		using namespace detail::LuaEvents;
+
+		auto& batch = Batch();
+		size_t delivered = hasFailed ? s_Cursor + 1 : batch.size(); //The failing event itself isn't retried
+
+		//Undelivered events keep their sequence numbers, so the next dispatch delivers them before whatever was queued since
+		if(delivered < batch.size()){
+			auto& shared = GetRegistry().Shared;
+			std::lock_guard<std::mutex> lock(shared.Mutex);
+			shared.Events.insert(shared.Events.end(), std::make_move_iterator(batch.begin() + delivered), std::make_move_iterator(batch.end()));
+		}
+
+		batch.clear();
+		s_IsDispatching = false;
+	}
+
+	int LuaEvents::DispatchBatch(lua_State* L)
+	{
+		using namespace detail::LuaEvents;
+
+		lua_rawgetp(L, LUA_REGISTRYINDEX, &s_HandlersKey);
+		int handlers = lua_gettop(L);
+		auto& batch = Batch();
+
+		for(; s_Cursor < batch.size(); ++s_Cursor)
+		{
+			const detail::QueuedEvent& e = batch[s_Cursor];
+
+			//Handler arrays are replaced rather than modified, so (un)subscribing from a handler doesn't affect this event
+			lua_rawgeti(L, handlers, e.Id);
+			if(!lua_istable(L, -1)){
+				lua_pop(L, 1);
+				continue;
+			}
+
+			int nrOfHandlers = static_cast<int>(lua_rawlen(L, -1));
+			for(int i = 1; i <= nrOfHandlers; ++i){
+				lua_rawgeti(L, -1, i);
+				lua_call(L, e.Push(L), 0);
+			}
+
+			lua_pop(L, 1);
+		}
+
+		return 0;
+	}
+
+	//Events.Subscribe(id, fn)
+	int LuaEvents::Subscribe(lua_State* L)
+	{
+		int id = static_cast<int>(luaL_checkinteger(L, 1));
+		luaL_checktype(L, 2, LUA_TFUNCTION);
+
+		lua_rawgetp(L, LUA_REGISTRYINDEX, &detail::LuaEvents::s_HandlersKey);
+		lua_rawgeti(L, 3, id);
+		int n = lua_istable(L, 4) ? static_cast<int>(lua_rawlen(L, 4)) : 0;
+
+		//Copy the handlers, the old array may be iterated by a dispatch in progress
+		lua_createtable(L, n + 1, 0);
+		for(int i = 1; i <= n; ++i){
+			lua_rawgeti(L, 4, i);
+			lua_rawseti(L, 5, i);
+		}
+		lua_pushvalue(L, 2);
+		lua_rawseti(L, 5, n + 1);
+
+		lua_rawseti(L, 3, id);
+		return 0;
+	}
+
+	//Events.Unsubscribe(id, fn), removes the first subscription of fn
+	int LuaEvents::Unsubscribe(lua_State* L)
+	{
+		int id = static_cast<int>(luaL_checkinteger(L, 1));
+		luaL_checktype(L, 2, LUA_TFUNCTION);
+
+		lua_rawgetp(L, LUA_REGISTRYINDEX, &detail::LuaEvents::s_HandlersKey);
+		lua_rawgeti(L, 3, id);
+		if(!lua_istable(L, 4))
+			return 0;
+
+		int n = static_cast<int>(lua_rawlen(L, 4));
+		lua_createtable(L, n, 0);
+
+		bool isRemoved = false;
+		int count = 0;
+		for(int i = 1; i <= n; ++i){
+			lua_rawgeti(L, 4, i);
+			if(!isRemoved && lua_rawequal(L, -1, 2)){
+				isRemoved = true;
+				lua_pop(L, 1);
+				continue;
+			}
+			lua_rawseti(L, 5, ++count);
+		}
+
+		if(count == 0)
+			lua_pushnil(L);
+		else
+			lua_pushvalue(L, 5);
+		lua_rawseti(L, 3, id);
+		return 0;
+	}
+}
+
+#endif
@@ -17,11 +17,14 @@
 
 #pragma once
 
-#include <lua.hpp>
+#include "LuaCompat.h"
 #include "TemplateUtil.h"
+#include "LuaMetrics.hpp"
+#include "LuaTrace.hpp"
 #include <map>
 #include <vector>
 #include <string>
+#include <type_traits>
 
 namespace LuaLink
 {
@@ -36,6 +39,15 @@ namespace LuaLink
         // // Add a C++ member function to the appropriate lookup table
         static void Register(_RetType(*pFunc)(_ArgTypes...), const char* name);
         
+        template<typename _RetType, typename... _ArgTypes>
+        // // Same as Register, but arguments are read without checking their type or count (validated when LUALINK_CHECK_TRUSTED is defined)
+        // // Only use for hot functions that are always called correctly, overloads fall back to the checked wrapper
+        static void RegisterTrusted(_RetType(*pFunc)(_ArgTypes...), const char* name);
+        
+        template<typename F>
+        // // Registers a lambda, functor or std::function (with a single, non-template operator()), a copy is moved into the Lua closure and destroyed with it
+        static typename std::enable_if<std::is_class<typename std::decay<F>::type>::value>::type Register(F&& functor, const char* name);
+        
         static int DefaultErrorHandling(lua_State* L, int narg);
 		
 	private:	
@@ -47,11 +59,16 @@ namespace LuaLink
 		// // Pushes all registered member functions to the Lua environment
 		static void Commit(lua_State* pLuaState);
 
-		// // Throws out all references to functions that are left over from previous commits
-		static void Release(void);
-
 		static int OverloadedErrorHandling(lua_State* L, int narg);
 
+#ifdef LUALINK_LUAJIT
+		// // Pushes the ffi module from package.loaded, opening it there only if no one did yet, pushes nil if it is unavailable
+		static void PushFFIModule(lua_State* L);
+
+		// // Pushes a cdata function pointer of the given C type, so LuaJIT can call pFunc without going through a lua_CFunction
+		static bool PushFFIFunction(lua_State* L, int ffiIdx, const char* signature, void* pFunc);
+#endif
+
 		// CALLBACK WRAPPERS
 	
 		// Tries out all overloads until it finds an overload that matches the arguments used in the Lua call
@@ -70,6 +87,8 @@ namespace LuaLink
         typedef int(*WrapperSingleArg)(lua_State*);
         
         template<typename _RetType, typename... _ArgTypes> struct FunctionWrapper;
+        template<typename _RetType, typename... _ArgTypes> struct TrustedFunctionWrapper;
+        template<typename F, typename _RetType, typename... _ArgTypes> struct FunctorWrapper;
     }
 }
 
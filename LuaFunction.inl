@@ -17,22 +17,168 @@
 
 #include "LuaStack.hpp"
 
-#include <iterator>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
 
 namespace LuaLink
 {
     namespace detail {
+#ifdef LUALINK_LUAJIT
+        namespace FFI {
+            //C names of the types the FFI converts to and from Lua values, nullptr for everything else
+            template<typename T> struct Type { static const char* name(void) { return nullptr; } };
+            
+            #define LUALINK_FFI_TYPE(TYPE) template<> struct Type<TYPE> { static const char* name(void) { return #TYPE; } };
+            LUALINK_FFI_TYPE(void)
+            LUALINK_FFI_TYPE(bool)
+            LUALINK_FFI_TYPE(char)
+            LUALINK_FFI_TYPE(signed char)
+            LUALINK_FFI_TYPE(unsigned char)
+            LUALINK_FFI_TYPE(short)
+            LUALINK_FFI_TYPE(unsigned short)
+            LUALINK_FFI_TYPE(int)
+            LUALINK_FFI_TYPE(unsigned int)
+            LUALINK_FFI_TYPE(long)
+            LUALINK_FFI_TYPE(unsigned long)
+            LUALINK_FFI_TYPE(long long)
+            LUALINK_FFI_TYPE(unsigned long long)
+            LUALINK_FFI_TYPE(float)
+            LUALINK_FFI_TYPE(double)
+            LUALINK_FFI_TYPE(const char*)
+            #undef LUALINK_FFI_TYPE
+            
+            template<typename... _ArgTypes> struct ArgList;
+            
+            template<>
+            struct ArgList<> { static bool append(std::string& s) { s += "void"; return true; } };
+            
+            template<typename T>
+            struct ArgList<T> { static bool append(std::string& s) { return Type<T>::name() && !std::is_same<T, void>::value && (s += Type<T>::name(), true); } };
+            
+            template<typename H, typename T2, typename... T>
+            struct ArgList<H, T2, T...> { static bool append(std::string& s) { return ArgList<H>::append(s) && (s += ", ", true) && ArgList<T2, T...>::append(s); } };
+            
+            template<typename _RetType, typename... _ArgTypes>
+            // // Declaration of a pointer to _RetType(*)(_ArgTypes...) for ffi.cast, e.g. "double(*)(double, int)"
+            struct Signature
+            {
+                static const char* get(void)
+                {
+                    static const std::string s = build();
+                    return s.empty() ? nullptr : s.c_str();
+                }
+                
+                static std::string build(void)
+                {
+                    //64-bit integers would be returned as boxed cdata, pointers as cdata instead of strings
+                    if(!Type<_RetType>::name() || std::is_same<_RetType, const char*>::value || (std::is_integral<_RetType>::value && sizeof(typename std::conditional<std::is_void<_RetType>::value, char, _RetType>::type) > 4))
+                        return std::string();
+                    
+                    std::string s = std::string(Type<_RetType>::name()) + "(*)(";
+                    if(!ArgList<_ArgTypes...>::append(s))
+                        return std::string();
+                    return s + ")";
+                }
+            };
+        }
+        
+        #define LUALINK_FFI_SIGNATURE(...) detail::FFI::Signature<__VA_ARGS__>::get
+#else
+        #define LUALINK_FFI_SIGNATURE(...) nullptr
+#endif
+        
         namespace LuaFunction {
             //Struct form of wrapper/callbacks, necessary to keep a lookup table of all wrappers/callbacks
             struct Unsafe_LuaFunc{
-                Unsafe_LuaFunc(WrapperDoubleArg w1, WrapperSingleArg w2, void* cb) : pWrapper(w1), pWrapperSingle(w2), pFunc(cb){}
+                Unsafe_LuaFunc(WrapperDoubleArg w1, WrapperSingleArg w2, void* cb, const char*(*ffi)(void) = nullptr, void*(*pushFunctor)(lua_State*, void*) = nullptr) : pWrapper(w1), pWrapperSingle(w2), pFunc(cb), pfnFFISignature(ffi), pfnPushFunctor(pushFunctor){}
                 
                 WrapperDoubleArg pWrapper; //Used for calls to overloaded member functions
                 WrapperSingleArg pWrapperSingle; //Used for calls to non-overloaded member functions
                 void* pFunc; //Serves as callback, discards type, wrappers restore type
+                const char*(*pfnFFISignature)(void); //LuaJIT only, returns the C declaration of pFunc's type or nullptr if FFI can't call it
+                void*(*pfnPushFunctor)(lua_State*, void*); //Functors only, moves the pending copy pFunc points to into a userdata and returns its new address
             };
             
             extern void Register_Impl(Unsafe_LuaFunc&&,const char*);
+            
+            // Owns functor copies that haven't been committed yet, those left over are destroyed on exit
+            extern void AddPendingFunctor(void* pPending, void(*destroy)(void*));
+            // Hands ownership of a pending functor copy to the caller
+            extern void* TakePendingFunctor(void* pPending);
+            
+            template<typename F>
+            void DestroyPendingFunctor(void* pPending) { delete static_cast<F*>(pPending); }
+            
+            // Pushes the closure calling a set of overloads, functors are moved into userdata upvalues that own them
+            // The second upvalue is the name the tracer records, "tableName.name" for static methods
+            extern void PushOverloads(lua_State* L, std::vector<Unsafe_LuaFunc>& overloads, lua_CFunction dispatch, const char* tableName, const char* name);
+            
+            template<typename F>
+            int DestroyFunctor(lua_State* L)
+            {
+                static_cast<F*>(lua_touserdata(L, 1))->~F();
+                return 0;
+            }
+            
+            template<typename F>
+            void* PushFunctor(lua_State* L, void* pPending)
+            {
+                static_assert(std::alignment_of<F>::value <= std::alignment_of<std::max_align_t>::value, "Over-aligned functors can't be stored in a Lua userdata");
+                
+                //The closure object lives inline in the userdata, calls reach it without another indirection
+                std::unique_ptr<F> pFunctor(static_cast<F*>(TakePendingFunctor(pPending)));
+                auto pStored = new (lua_newuserdata(L, sizeof(F))) F(std::move(*pFunctor));
+                
+                if(!std::is_trivially_destructible<F>::value){
+                    lua_createtable(L, 0, 1);
+                    lua_pushcfunction(L, DestroyFunctor<F>);
+                    lua_setfield(L, -2, "__gc");
+                    lua_setmetatable(L, -2);
+                }
+                return pStored;
+            }
+            
+            template<typename F, typename CallOperator> struct FunctorBinding;
+            
+            template<typename F, typename C, typename _RetType, typename... _ArgTypes>
+            struct FunctorBinding<F, _RetType(C::*)(_ArgTypes...)>
+            {
+                typedef FunctorWrapper<F, _RetType, _ArgTypes...> Wrapper;
+            };
+            
+            template<typename F, typename C, typename _RetType, typename... _ArgTypes>
+            struct FunctorBinding<F, _RetType(C::*)(_ArgTypes...) const> : FunctorBinding<F, _RetType(C::*)(_ArgTypes...)> {};
+            
+            template<typename F>
+            // Copies the functor until it is committed, the signature is taken from its operator()
+            Unsafe_LuaFunc MakeFunctorFunc(F&& functor)
+            {
+                typedef typename std::decay<F>::type Functor;
+                typedef typename FunctorBinding<Functor, decltype(&Functor::operator())>::Wrapper Wrapper;
+                
+                std::unique_ptr<Functor> pPending(new Functor(std::forward<F>(functor)));
+                AddPendingFunctor(pPending.get(), DestroyPendingFunctor<Functor>);
+                return Unsafe_LuaFunc(Wrapper::execute, Wrapper::execute, pPending.release(), nullptr, PushFunctor<Functor>);
+            }
+            
+            //Closures carry their overload sets as a full userdata upvalue: [count][T, T, ...]
+            template<typename T>
+            void PushCallables(lua_State* L, const std::vector<T>& callables)
+            {
+                auto pCount = static_cast<size_t*>(lua_newuserdata(L, sizeof(size_t) + callables.size() * sizeof(T)));
+                *pCount = callables.size();
+                std::uninitialized_copy(callables.begin(), callables.end(), reinterpret_cast<T*>(pCount + 1));
+            }
+            
+            template<typename T>
+            const T* ToCallables(lua_State* L, int idx, size_t& count)
+            {
+                auto pCount = static_cast<const size_t*>(lua_touserdata(L, idx));
+                count = *pCount;
+                return reinterpret_cast<const T*>(pCount + 1);
+            }
         }
     }
     
@@ -45,7 +191,26 @@ namespace LuaLink
         detail::LuaFunction::Register_Impl(Unsafe_LuaFunc(
                                      FunctionWrapper<_RetType, _ArgTypes...>::execute,
                                      FunctionWrapper<_RetType, _ArgTypes...>::execute,
-                                     reinterpret_cast<void*>(pFunc)), name);
+                                     reinterpret_cast<void*>(pFunc),
+                                     LUALINK_FFI_SIGNATURE(_RetType, _ArgTypes...)), name);
+	}
+    
+	template<typename _RetType, typename... _ArgTypes>
+	void LuaFunction::RegisterTrusted(_RetType(*pFunc)(_ArgTypes...), const char* name)
+    {
+        using namespace detail;
+        using namespace detail::LuaFunction;
+        detail::LuaFunction::Register_Impl(Unsafe_LuaFunc(
+                                     FunctionWrapper<_RetType, _ArgTypes...>::execute,
+                                     TrustedFunctionWrapper<_RetType, _ArgTypes...>::execute,
+                                     reinterpret_cast<void*>(pFunc),
+                                     LUALINK_FFI_SIGNATURE(_RetType, _ArgTypes...)), name);
+	}
+    
+	template<typename F>
+	typename std::enable_if<std::is_class<typename std::decay<F>::type>::value>::type LuaFunction::Register(F&& functor, const char* name)
+    {
+        detail::LuaFunction::Register_Impl(detail::LuaFunction::MakeFunctorFunc(std::forward<F>(functor)), name);
 	}
 }
 
@@ -59,17 +224,70 @@ namespace LuaLink {
                 return s;
             }
             
-            std::vector<Unsafe_LuaFunc>& LuaFunctionTable() {
-                static std::vector<Unsafe_LuaFunc> s;
+            struct PendingFunctors
+            {
+                ~PendingFunctors(void)
+                {
+                    for(auto& elem : Functors)
+                        elem.second(elem.first);
+                }
+                
+                std::unordered_map<void*, void(*)(void*)> Functors; //Copy -> its deleter
+            };
+            
+            static PendingFunctors& GetPendingFunctors(void) {
+                static PendingFunctors s;
                 return s;
             }
             
+            void AddPendingFunctor(void* pPending, void(*destroy)(void*)) {
+                GetPendingFunctors().Functors[pPending] = destroy;
+            }
+            
+            void* TakePendingFunctor(void* pPending) {
+                GetPendingFunctors().Functors.erase(pPending);
+                return pPending;
+            }
+            
             void Register_Impl(Unsafe_LuaFunc&& func, const char* name) {
                     auto it = LuaFunctionMap().find(name);
                     if( it == LuaFunctionMap().end() )
                         it = LuaFunctionMap().insert(make_pair(name, std::vector<Unsafe_LuaFunc>() ) ).first;
                     it->second.push_back(func);
             }
+            
+            void PushOverloads(lua_State* L, std::vector<Unsafe_LuaFunc>& overloads, lua_CFunction dispatch, const char* tableName, const char* name)
+            {
+                //No overloading, the callback and the name are the only upvalues
+                if(overloads.size() == 1){
+                    if(overloads[0].pfnPushFunctor)
+                        overloads[0].pFunc = overloads[0].pfnPushFunctor(L, overloads[0].pFunc);
+                    else
+                        lua_pushlightuserdata(L, overloads[0].pFunc);
+                    overloads[0].pfnPushFunctor = nullptr;
+                    
+                    Trace::PushName(L, tableName, name);
+                    lua_pushcclosure(L, overloads[0].pWrapperSingle, 2);
+                    return;
+                }
+                
+                //Functors are anchored as extra upvalues, the overload set and the name stay the first ones
+                int nrOfFunctors = 0;
+                for(auto& overload : overloads){
+                    if(!overload.pfnPushFunctor)
+                        continue;
+                    
+                    overload.pFunc = overload.pfnPushFunctor(L, overload.pFunc);
+                    overload.pfnPushFunctor = nullptr;
+                    ++nrOfFunctors;
+                }
+                
+                PushCallables(L, overloads);
+                Trace::PushName(L, tableName, name);
+                lua_insert(L, -(nrOfFunctors + 2));
+                lua_insert(L, -(nrOfFunctors + 2));
+                lua_pushcclosure(L, dispatch, nrOfFunctors + 2);
+            }
         }
     }
     
@@ -78,49 +296,95 @@ namespace LuaLink {
     {
         using namespace detail::LuaFunction;
         
+#ifdef LUALINK_LUAJIT
+        //Opened once, every luaopen_ffi call replaces the C type state and invalidates the ctypes cast before
+        PushFFIModule(pLuaState);
+        int ffiIdx = lua_gettop(pLuaState);
+        bool isTracing = LuaTrace::IsRecording();
+#endif
+        
         for(auto& elem : LuaFunctionMap()) {
-            //No overloading
-            if(elem.second.size() == 1){
-                lua_pushlightuserdata(pLuaState, elem.second[0].pFunc);
-                lua_pushcclosure(pLuaState, elem.second[0].pWrapperSingle, 1);
-                lua_setglobal(pLuaState, elem.first );
+#ifdef LUALINK_LUAJIT
+            //Plain C signatures without overloads are called through the FFI, the JIT compiles those calls into traces
+            //FFI calls bypass the wrappers that trace, so everything keeps its wrapper while the tracer is recording
+            if(!isTracing && elem.second.size() == 1 && elem.second[0].pfnFFISignature && PushFFIFunction(pLuaState, ffiIdx, elem.second[0].pfnFFISignature(), elem.second[0].pFunc)){
+                lua_setglobal(pLuaState, elem.first);
                 continue;
             }
+#endif
             
-            //Copy function objects to table
-            size_t startIdx = LuaFunctionTable().size();
-            size_t endIdx = startIdx + elem.second.size();
-            
-            std::move(elem.second.begin(), elem.second.end(), std::insert_iterator<std::vector<Unsafe_LuaFunc>>(LuaFunctionTable(), LuaFunctionTable().end()));
-            
-            //Push start and end indices
-            lua_pushinteger(pLuaState, (lua_Integer)startIdx);
-            lua_pushinteger(pLuaState, (lua_Integer)endIdx);
-            
-            //Push closure
-            lua_pushcclosure(pLuaState, LuaFunctionDispatch, 2);
+            //Push the callback, or the overloads, as upvalue of the closure
+            PushOverloads(pLuaState, elem.second, LuaFunctionDispatch, nullptr, elem.first);
             lua_setglobal(pLuaState, elem.first);
         }
         LuaFunctionMap().clear();
+        
+#ifdef LUALINK_LUAJIT
+        lua_remove(pLuaState, ffiIdx);
+#endif
     }
     
-    // // Throws out all references to functions that are left over from previous commits
-    void LuaFunction::Release(void)
+#ifdef LUALINK_LUAJIT
+    void LuaFunction::PushFFIModule(lua_State* L)
     {
-        using namespace detail::LuaFunction;
-        if(!LuaFunctionTable().empty())
-            LuaFunctionTable().clear();
+        //package.loaded, which require("ffi") looks in first
+        lua_getfield(L, LUA_REGISTRYINDEX, "_LOADED");
+        if(!lua_istable(L, -1)){
+            lua_pop(L, 1);
+            lua_pushnil(L);
+            return;
+        }
+        
+        lua_getfield(L, -1, "ffi");
+        if(!lua_istable(L, -1)){
+            lua_pop(L, 1);
+            
+            lua_pushcfunction(L, luaopen_ffi);
+            if(lua_pcall(L, 0, 1, 0) != 0 || !lua_istable(L, -1)){
+                lua_pop(L, 2);
+                lua_pushnil(L);
+                return;
+            }
+            
+            lua_pushvalue(L, -1);
+            lua_setfield(L, -3, "ffi");
+        }
+        
+        lua_remove(L, -2); //Remove package.loaded
     }
     
+    // // Pushes ffi.cast(signature, pFunc), returns false (pushing nothing) if that fails
+    bool LuaFunction::PushFFIFunction(lua_State* L, int ffiIdx, const char* signature, void* pFunc)
+    {
+        if(!signature || !lua_istable(L, ffiIdx))
+            return false;
+        
+        int top = lua_gettop(L);
+        
+        lua_getfield(L, ffiIdx, "cast");
+        lua_pushstring(L, signature);
+        lua_pushlightuserdata(L, pFunc);
+        if(lua_pcall(L, 2, 1, 0) != 0){
+            lua_settop(L, top);
+            return false;
+        }
+        
+        return true;
+    }
+#endif
+    
     // Tries out all overloads until it finds an overload that matches the arguments used in the Lua call
     int LuaFunction::LuaFunctionDispatch(lua_State* L)
     {
         using namespace detail::LuaFunction;
-        auto startIdx = static_cast<int>( lua_tointeger( L, lua_upvalueindex(1) ) );
-        auto endIdx =	static_cast<int>( lua_tointeger( L, lua_upvalueindex(2) ) );
+        detail::Metrics::CountBindingCall();
+        detail::Trace::Scope traceScope(L, lua_upvalueindex(2));
+        
+        size_t count = 0;
+        auto pOverloads = ToCallables<Unsafe_LuaFunc>(L, lua_upvalueindex(1), count);
         
-        for(auto i = startIdx; i < endIdx; ++i){
-            auto ret = LuaFunctionTable()[i].pWrapper(L, LuaFunctionTable()[i].pFunc, OverloadedErrorHandling);
+        for(size_t i = 0; i < count; ++i){
+            auto ret = pOverloads[i].pWrapper(L, pOverloads[i].pFunc, OverloadedErrorHandling);
             if(ret < 0)
                 continue;
             
@@ -135,7 +399,10 @@ namespace LuaLink {
 
 	// CALLBACK WRAPPERS
 
-	#define EXECUTE_V2	static int execute(lua_State* pLuaState){return execute(pLuaState, lua_touserdata( pLuaState, lua_upvalueindex(1) ), ::LuaLink::LuaFunction::DefaultErrorHandling);}
+	#define EXECUTE_V2	static int execute(lua_State* pLuaState){ \
+		::LuaLink::detail::Metrics::CountBindingCall(); \
+		::LuaLink::detail::Trace::Scope traceScope(pLuaState, lua_upvalueindex(2)); \
+		return execute(pLuaState, lua_touserdata( pLuaState, lua_upvalueindex(1) ), ::LuaLink::LuaFunction::DefaultErrorHandling);}
 
     namespace detail {
         //functionwrapper
@@ -148,7 +415,7 @@ namespace LuaLink {
             
             static int execute(lua_State* pLuaState, void* fn, ArgErrorCbType onArgError)
             {
-                bool isOk = lua_gettop(pLuaState) == sizeof...(_ArgTypes);
+                bool isOk = CheckArgCount<_ArgTypes...>(pLuaState, lua_gettop(pLuaState));
                 if(!isOk)
                     return onArgError(pLuaState, 0);
                 
@@ -157,8 +424,8 @@ namespace LuaLink {
                 if(!isOk)
                     return err;
                 
-                LuaStack::pushVariable<_RetType>( pLuaState, call(reinterpret_cast<CbType>(fn), tpl) );
-                return 1;
+                Results<_RetType>::push( pLuaState, call(reinterpret_cast<CbType>(fn), tpl) );
+                return ResultCount<_RetType>::value;
             }
             
             EXECUTE_V2
@@ -172,7 +439,7 @@ namespace LuaLink {
             
             static int execute(lua_State* pLuaState, void* fn, ArgErrorCbType onArgError)
             {
-                bool isOk = lua_gettop(pLuaState) == sizeof...(_ArgTypes);
+                bool isOk = CheckArgCount<_ArgTypes...>(pLuaState, lua_gettop(pLuaState));
                 if(!isOk)
                     return onArgError(pLuaState, 0);
                 
@@ -199,8 +466,8 @@ namespace LuaLink {
                 if(lua_gettop(pLuaState) != 0) //argc
                     return onArgError(pLuaState, 0);
                 
-                LuaStack::pushVariable<_RetType>( pLuaState, reinterpret_cast<CbType>(fn)() );
-                return 1;
+                Results<_RetType>::push( pLuaState, reinterpret_cast<CbType>(fn)() );
+                return ResultCount<_RetType>::value;
             }
             
             EXECUTE_V2
@@ -222,6 +489,123 @@ namespace LuaLink {
             
             EXECUTE_V2
         };
+        
+        //trusted, ret
+        template<typename _RetType, typename... _ArgTypes>
+        struct TrustedFunctionWrapper
+        {
+            typedef _RetType(*CbType)(_ArgTypes...);
+            
+            static int execute(lua_State* pLuaState)
+            {
+#ifdef LUALINK_CHECK_TRUSTED
+                return FunctionWrapper<_RetType, _ArgTypes...>::execute(pLuaState);
+#else
+                Metrics::CountBindingCall();
+                Trace::Scope traceScope(pLuaState, lua_upvalueindex(2));
+                auto fn = reinterpret_cast<CbType>(lua_touserdata( pLuaState, lua_upvalueindex(1) ));
+                Results<_RetType>::push( pLuaState, call_trusted(pLuaState, fn) );
+                return ResultCount<_RetType>::value;
+#endif
+            }
+        };
+        
+        //trusted, no ret
+        template<typename... _ArgTypes>
+        struct TrustedFunctionWrapper<void, _ArgTypes...>
+        {
+            typedef void(*CbType)(_ArgTypes...);
+            
+            static int execute(lua_State* pLuaState)
+            {
+#ifdef LUALINK_CHECK_TRUSTED
+                return FunctionWrapper<void, _ArgTypes...>::execute(pLuaState);
+#else
+                Metrics::CountBindingCall();
+                Trace::Scope traceScope(pLuaState, lua_upvalueindex(2));
+                auto fn = reinterpret_cast<CbType>(lua_touserdata( pLuaState, lua_upvalueindex(1) ));
+                call_trusted(pLuaState, fn);
+                return 0;
+#endif
+            }
+        };
+        
+        //functor, ret
+        template<typename F, typename _RetType, typename... _ArgTypes>
+        struct FunctorWrapper
+        {
+            static int execute(lua_State* pLuaState, void* fn, ArgErrorCbType onArgError)
+            {
+                bool isOk = CheckArgCount<_ArgTypes...>(pLuaState, lua_gettop(pLuaState));
+                if(!isOk)
+                    return onArgError(pLuaState, 0);
+                
+                int err = 0;
+                auto tpl = build_tuple_from_lua_stack<_ArgTypes...>::execute(pLuaState, 1, isOk, onArgError, err);
+                if(!isOk)
+                    return err;
+                
+                //Called by reference, the functor stays in its userdata
+                Results<_RetType>::push( pLuaState, call<F&>(*static_cast<F*>(fn), tpl) );
+                return ResultCount<_RetType>::value;
+            }
+            
+            EXECUTE_V2
+        };
+        
+        //functor, no ret
+        template<typename F, typename... _ArgTypes>
+        struct FunctorWrapper<F, void, _ArgTypes...>
+        {
+            static int execute(lua_State* pLuaState, void* fn, ArgErrorCbType onArgError)
+            {
+                bool isOk = CheckArgCount<_ArgTypes...>(pLuaState, lua_gettop(pLuaState));
+                if(!isOk)
+                    return onArgError(pLuaState, 0);
+                
+                int err = 0;
+                auto tpl = build_tuple_from_lua_stack<_ArgTypes...>::execute(pLuaState, 1, isOk, onArgError, err);
+                if(!isOk)
+                    return err;
+                
+                call<F&>(*static_cast<F*>(fn), tpl);
+                return 0;
+            }
+            
+            EXECUTE_V2
+        };
+        
+        //functor, ret, 0 arg
+        template<typename F, typename _RetType>
+        struct FunctorWrapper<F, _RetType>
+        {
+            static int execute(lua_State* pLuaState, void* fn, ArgErrorCbType onArgError)
+            {
+                if(lua_gettop(pLuaState) != 0) //argc
+                    return onArgError(pLuaState, 0);
+                
+                Results<_RetType>::push( pLuaState, (*static_cast<F*>(fn))() );
+                return ResultCount<_RetType>::value;
+            }
+            
+            EXECUTE_V2
+        };
+        
+        //functor, no ret, 0 arg
+        template<typename F>
+        struct FunctorWrapper<F, void>
+        {
+            static int execute(lua_State* pLuaState, void* fn, ArgErrorCbType onArgError)
+            {
+                if(lua_gettop(pLuaState) != 0) //argc
+                    return onArgError(pLuaState, 0);
+                
+                (*static_cast<F*>(fn))();
+                return 0;
+            }
+            
+            EXECUTE_V2
+        };
     }
 
 	#undef EXECUTE_V2
@@ -0,0 +1,16 @@
+//
+//  Bench.h
+//  LuaLinkBench
+//
+//  Declarations shared between the benchmark driver and its bindings.
+//
+
+#pragma once
+
+#include <lua.hpp>
+
+//Registers the global functions and overload sets used by bench.lua (pass to LuaScript::Load)
+void InitBenchEnvironment(void);
+
+//Creates a plain lua_State with the same functions and classes bound by hand, then runs script in it
+lua_State* CreateRawBenchState(const char* script);
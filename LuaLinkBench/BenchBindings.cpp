@@ -0,0 +1,305 @@
+//
+//  BenchBindings.cpp
+//  LuaLinkBench
+//
+//  Functions and classes exposed through LuaLink, and their hand-written
+//  Lua C API counterparts that serve as the baseline.
+//
+
+#include <new>
+#include "LuaLink"
+#include "Bench.h"
+
+using namespace LuaLink;
+
+//Global functions
+
+static int Cfn0(void) { return 0; }
+static int Cfn1(int a) { return a; }
+static int Cfn2(int a, int b) { return a + b; }
+static int Cfn3(int a, int b, int c) { return a + b + c; }
+static int Cfn4(int a, int b, int c, int d) { return a + b + c + d; }
+
+//Numeric helpers, bound both checked and trusted
+
+static double Num1(double a) { return a * 2.0; }
+static double Num2(double a, double b) { return a * b; }
+static double Num3(double a, double b, double c) { return a * b + c; }
+static double Num4(double a, double b, double c, double d) { return a * b + c * d; }
+static double Num5(double a, double b, double c, double d, double e) { return a * b + c * d + e; }
+static double Num6(double a, double b, double c, double d, double e, double f) { return a * b + c * d + e * f; }
+
+//Overload candidates, told apart by their number of arguments
+
+static int Ovl0(void) { return 0; }
+static int Ovl1(int a) { return a; }
+static int Ovl2(int a, int b) { return a + b; }
+static int Ovl3(int a, int b, int c) { return a + b + c; }
+static int Ovl4(int a, int b, int c, int d) { return a + b + c + d; }
+static int Ovl5(int a, int b, int c, int d, int e) { return a + b + c + d + e; }
+static int Ovl6(int a, int b, int c, int d, int e, int f) { return a + b + c + d + e + f; }
+static int Ovl7(int a, int b, int c, int d, int e, int f, int g) { return a + b + c + d + e + f + g; }
+
+void InitBenchEnvironment(void)
+{
+    LuaFunction::Register(Cfn0, "cfn0");
+    LuaFunction::Register(Cfn1, "cfn1");
+    LuaFunction::Register(Cfn2, "cfn2");
+    LuaFunction::Register(Cfn3, "cfn3");
+    LuaFunction::Register(Cfn4, "cfn4");
+
+    //Capturing lambda stored in its closure, compared against cfn2
+    int offset = 0;
+    LuaFunction::Register([offset](int a, int b) { return a + b + offset; }, "lfn2");
+
+    LuaFunction::Register(Num1, "num1");
+    LuaFunction::Register(Num2, "num2");
+    LuaFunction::Register(Num3, "num3");
+    LuaFunction::Register(Num4, "num4");
+    LuaFunction::Register(Num5, "num5");
+    LuaFunction::Register(Num6, "num6");
+
+    LuaFunction::RegisterTrusted(Num1, "tnum1");
+    LuaFunction::RegisterTrusted(Num2, "tnum2");
+    LuaFunction::RegisterTrusted(Num3, "tnum3");
+    LuaFunction::RegisterTrusted(Num4, "tnum4");
+    LuaFunction::RegisterTrusted(Num5, "tnum5");
+    LuaFunction::RegisterTrusted(Num6, "tnum6");
+
+    //Same helpers bound as functors, which never become FFI calls: call_heavy/wrapper against call_heavy shows what FFI gains on LuaJIT
+    LuaFunction::Register([](double a, double b) { return Num2(a, b); }, "wnum2");
+    LuaFunction::Register([](double a, double b, double c, double d) { return Num4(a, b, c, d); }, "wnum4");
+
+    //Candidates are tried in registration order, bench.lua always calls the last one
+    LuaFunction::Register(Ovl0, "ovl2");
+    LuaFunction::Register(Ovl1, "ovl2");
+
+    LuaFunction::Register(Ovl0, "ovl4");
+    LuaFunction::Register(Ovl1, "ovl4");
+    LuaFunction::Register(Ovl2, "ovl4");
+    LuaFunction::Register(Ovl3, "ovl4");
+
+    LuaFunction::Register(Ovl0, "ovl8");
+    LuaFunction::Register(Ovl1, "ovl8");
+    LuaFunction::Register(Ovl2, "ovl8");
+    LuaFunction::Register(Ovl3, "ovl8");
+    LuaFunction::Register(Ovl4, "ovl8");
+    LuaFunction::Register(Ovl5, "ovl8");
+    LuaFunction::Register(Ovl6, "ovl8");
+    LuaFunction::Register(Ovl7, "ovl8");
+}
+
+//Bound class
+
+class Counter {
+    int m_Value;
+
+public:
+    Counter(int value):m_Value(value){}
+
+    int Get(void){ return m_Value; }
+    void Add(int amount){ m_Value += amount; }
+    void Add2(int a, int b){ m_Value += a + b; }
+
+    //Passthrough function to expose constructor, note that we return void*
+    static void* LuaNew(int value){ return static_cast<void*>(new Counter(value)); }
+
+    //Used by the raw baseline only
+    void Set(int value){ m_Value = value; }
+
+    LUACLASS_DECLARATION(Counter);
+};
+
+LUACLASS(Counter);
+
+LUASTATICS(Counter) {
+    LUAMETHOD(Get);
+    LUAMETHOD(Add);
+    LUAMETHOD(Add2);
+
+    LUASTATICMETHOD(LuaNew, "new");
+}
+
+LUAMEMBERS(Counter) {
+    LUAMEMBER(m_Value, "Value");
+}
+
+//Same class, constructed inside its Lua userdata instead of through a void* returning static
+
+class InPlaceCounter {
+    int m_Value;
+
+public:
+    InPlaceCounter(int value):m_Value(value){}
+
+    int Get(void){ return m_Value; }
+    void Add(int amount){ m_Value += amount; }
+
+    LUACLASS_DECLARATION(InPlaceCounter);
+};
+
+LUACLASS(InPlaceCounter);
+
+LUASTATICS(InPlaceCounter) {
+    LUAMETHOD(Get);
+    LUAMETHOD(Add);
+
+    LUACONSTRUCTOR(int);
+}
+
+LUAMEMBERS(InPlaceCounter) {
+    LUAMEMBER(m_Value, "Value");
+}
+
+//Same again, with collected objects recycled through the class's pool
+
+class PooledCounter {
+    int m_Value;
+
+public:
+    PooledCounter(int value):m_Value(value){}
+
+    int Get(void){ return m_Value; }
+    void Add(int amount){ m_Value += amount; }
+
+    LUACLASS_DECLARATION(PooledCounter);
+};
+
+LUACLASS(PooledCounter);
+
+LUASTATICS(PooledCounter) {
+    LUAMETHOD(Get);
+    LUAMETHOD(Add);
+
+    LUACONSTRUCTOR(int);
+    LUAPOOL(1024);
+}
+
+LUAMEMBERS(PooledCounter) {
+    LUAMEMBER(m_Value, "Value");
+}
+
+//Raw Lua C API baseline
+
+namespace {
+    int RawCfn0(lua_State* L) { lua_pushinteger(L, Cfn0()); return 1; }
+    int RawCfn1(lua_State* L) { lua_pushinteger(L, Cfn1((int)luaL_checkinteger(L, 1))); return 1; }
+    int RawCfn2(lua_State* L) { lua_pushinteger(L, Cfn2((int)luaL_checkinteger(L, 1), (int)luaL_checkinteger(L, 2))); return 1; }
+    int RawCfn3(lua_State* L) { lua_pushinteger(L, Cfn3((int)luaL_checkinteger(L, 1), (int)luaL_checkinteger(L, 2), (int)luaL_checkinteger(L, 3))); return 1; }
+    int RawCfn4(lua_State* L) { lua_pushinteger(L, Cfn4((int)luaL_checkinteger(L, 1), (int)luaL_checkinteger(L, 2), (int)luaL_checkinteger(L, 3), (int)luaL_checkinteger(L, 4))); return 1; }
+
+    //Checked baseline for num1-6, the trusted baseline reads with lua_tonumber instead
+    double Arg(lua_State* L, int idx) { return luaL_checknumber(L, idx); }
+    double TrustedArg(lua_State* L, int idx) { return lua_tonumber(L, idx); }
+
+    template<double(*Read)(lua_State*, int)> int RawNum1(lua_State* L) { lua_pushnumber(L, Num1(Read(L, 1))); return 1; }
+    template<double(*Read)(lua_State*, int)> int RawNum2(lua_State* L) { lua_pushnumber(L, Num2(Read(L, 1), Read(L, 2))); return 1; }
+    template<double(*Read)(lua_State*, int)> int RawNum3(lua_State* L) { lua_pushnumber(L, Num3(Read(L, 1), Read(L, 2), Read(L, 3))); return 1; }
+    template<double(*Read)(lua_State*, int)> int RawNum4(lua_State* L) { lua_pushnumber(L, Num4(Read(L, 1), Read(L, 2), Read(L, 3), Read(L, 4))); return 1; }
+    template<double(*Read)(lua_State*, int)> int RawNum5(lua_State* L) { lua_pushnumber(L, Num5(Read(L, 1), Read(L, 2), Read(L, 3), Read(L, 4), Read(L, 5))); return 1; }
+    template<double(*Read)(lua_State*, int)> int RawNum6(lua_State* L) { lua_pushnumber(L, Num6(Read(L, 1), Read(L, 2), Read(L, 3), Read(L, 4), Read(L, 5), Read(L, 6))); return 1; }
+
+    //What a hand-written binding does instead of trying candidates: switch on the argument count
+    int RawOverloaded(lua_State* L)
+    {
+        lua_Integer sum = 0;
+        int argc = lua_gettop(L);
+        if(argc >= (int)lua_tointeger(L, lua_upvalueindex(1)))
+            return luaL_error(L, "Invalid function call");
+
+        for(int i = 1; i <= argc; ++i)
+            sum += luaL_checkinteger(L, i);
+
+        lua_pushinteger(L, sum);
+        return 1;
+    }
+
+    Counter* RawCheckCounter(lua_State* L) { return static_cast<Counter*>(luaL_checkudata(L, 1, "Counter")); }
+
+    int RawCounterNew(lua_State* L)
+    {
+        int value = (int)luaL_checkinteger(L, 1);
+        new (lua_newuserdata(L, sizeof(Counter))) Counter(value);
+        luaL_setmetatable(L, "Counter");
+        return 1;
+    }
+
+    int RawCounterGc(lua_State* L) { RawCheckCounter(L)->~Counter(); return 0; }
+    int RawCounterGet(lua_State* L) { lua_pushinteger(L, RawCheckCounter(L)->Get()); return 1; }
+    int RawCounterAdd(lua_State* L) { RawCheckCounter(L)->Add((int)luaL_checkinteger(L, 2)); return 0; }
+    int RawCounterAdd2(lua_State* L) { RawCheckCounter(L)->Add2((int)luaL_checkinteger(L, 2), (int)luaL_checkinteger(L, 3)); return 0; }
+    int RawCounterSet(lua_State* L) { RawCheckCounter(L)->Set((int)luaL_checkinteger(L, 2)); return 0; }
+
+    void RawRegisterOverloaded(lua_State* L, const char* name, int nrOfCandidates)
+    {
+        lua_pushinteger(L, nrOfCandidates);
+        lua_pushcclosure(L, RawOverloaded, 1);
+        lua_setglobal(L, name);
+    }
+}
+
+lua_State* CreateRawBenchState(const char* script)
+{
+    lua_State* L = luaL_newstate();
+    if(!L)
+        return nullptr;
+
+    luaL_openlibs(L);
+
+    if(luaL_dofile(L, script) != 0){
+        lua_close(L);
+        return nullptr;
+    }
+
+    lua_register(L, "cfn0", RawCfn0);
+    lua_register(L, "cfn1", RawCfn1);
+    lua_register(L, "cfn2", RawCfn2);
+    lua_register(L, "cfn3", RawCfn3);
+    lua_register(L, "cfn4", RawCfn4);
+
+    lua_register(L, "num1", RawNum1<Arg>);
+    lua_register(L, "num2", RawNum2<Arg>);
+    lua_register(L, "num3", RawNum3<Arg>);
+    lua_register(L, "num4", RawNum4<Arg>);
+    lua_register(L, "num5", RawNum5<Arg>);
+    lua_register(L, "num6", RawNum6<Arg>);
+
+    lua_register(L, "tnum1", RawNum1<TrustedArg>);
+    lua_register(L, "tnum2", RawNum2<TrustedArg>);
+    lua_register(L, "tnum3", RawNum3<TrustedArg>);
+    lua_register(L, "tnum4", RawNum4<TrustedArg>);
+    lua_register(L, "tnum5", RawNum5<TrustedArg>);
+    lua_register(L, "tnum6", RawNum6<TrustedArg>);
+
+    RawRegisterOverloaded(L, "ovl2", 2);
+    RawRegisterOverloaded(L, "ovl4", 4);
+    RawRegisterOverloaded(L, "ovl8", 8);
+
+    //Metatable for Counter userdata, methods are looked up in the metatable itself
+    static const luaL_Reg counterMethods[] = {
+        { "__gc", RawCounterGc },
+        { "Get", RawCounterGet },
+        { "Add", RawCounterAdd },
+        { "Add2", RawCounterAdd2 },
+        { "GetValue", RawCounterGet },
+        { "SetValue", RawCounterSet },
+        { nullptr, nullptr }
+    };
+    luaL_newmetatable(L, "Counter");
+    luaL_setfuncs(L, counterMethods, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    //Class table, also serves as baseline for InPlaceCounter and PooledCounter
+    lua_newtable(L);
+    lua_pushcfunction(L, RawCounterNew);
+    lua_setfield(L, -2, "new");
+    lua_pushvalue(L, -1);
+    lua_setglobal(L, "Counter");
+    lua_pushvalue(L, -1);
+    lua_setglobal(L, "InPlaceCounter");
+    lua_setglobal(L, "PooledCounter");
+
+    return L;
+}
@@ -0,0 +1,134 @@
+--bench.lua
+--Loaded into both the LuaLink state and the raw Lua C API baseline state.
+--Nothing at file scope may touch a binding, the raw state registers its own
+--functions and classes under the same names after loading this chunk.
+
+--C++ -> Lua: targets of CallFunction
+
+function f0() return 0 end
+function f1(a) return a end
+function f2(a, b) return a + b end
+function f3(a, b, c) return a + b + c end
+function f4(a, b, c, d) return a + b + c + d end
+function f5(a, b, c, d, e) return a + b + c + d + e end
+function f6(a, b, c, d, e, f) return a + b + c + d + e + f end
+function f7(a, b, c, d, e, f, g) return a + b + c + d + e + f + g end
+function f8(a, b, c, d, e, f, g, h) return a + b + c + d + e + f + g + h end
+
+--C++ -> Lua: targets of CallMethod
+
+M = {}
+M.f0 = f0
+M.f1 = f1
+M.f2 = f2
+M.f3 = f3
+M.f4 = f4
+M.f5 = f5
+M.f6 = f6
+M.f7 = f7
+M.f8 = f8
+
+--C++ -> Lua: events, delivered through a Lua-side dispatcher by name or through the LuaLink event bus by id
+
+EventCount = 0
+local function on_game_start(a) EventCount = EventCount + 1 end
+
+EventHandler = { handlers = { GameStart = { on_game_start } } }
+function EventHandler.TriggerEvent(name, a)
+	for _, h in ipairs(EventHandler.handlers[name]) do h(a) end
+end
+
+--Only the LuaLink state has an event bus
+if Events then Events.Subscribe(1, on_game_start) end
+
+--Lua -> C++: global functions
+
+function call_cfn0(n) local f = cfn0 for i = 1, n do f() end return n end
+function call_cfn1(n) local f = cfn1 for i = 1, n do f(i) end return n end
+function call_cfn2(n) local f = cfn2 for i = 1, n do f(i, 1) end return n end
+function call_cfn3(n) local f = cfn3 for i = 1, n do f(i, 1, 2) end return n end
+function call_cfn4(n) local f = cfn4 for i = 1, n do f(i, 1, 2, 3) end return n end
+function call_lfn2(n) local f = lfn2 for i = 1, n do f(i, 1) end return n end
+
+--Lua -> C++: numeric functions, checked and trusted
+
+function call_num1(n) local f = num1 for i = 1, n do f(i) end return n end
+function call_num2(n) local f = num2 for i = 1, n do f(i, 0.5) end return n end
+function call_num3(n) local f = num3 for i = 1, n do f(i, 0.5, 1) end return n end
+function call_num4(n) local f = num4 for i = 1, n do f(i, 0.5, 1, 1.5) end return n end
+function call_num5(n) local f = num5 for i = 1, n do f(i, 0.5, 1, 1.5, 2) end return n end
+function call_num6(n) local f = num6 for i = 1, n do f(i, 0.5, 1, 1.5, 2, 2.5) end return n end
+
+function call_tnum1(n) local f = tnum1 for i = 1, n do f(i) end return n end
+function call_tnum2(n) local f = tnum2 for i = 1, n do f(i, 0.5) end return n end
+function call_tnum3(n) local f = tnum3 for i = 1, n do f(i, 0.5, 1) end return n end
+function call_tnum4(n) local f = tnum4 for i = 1, n do f(i, 0.5, 1, 1.5) end return n end
+function call_tnum5(n) local f = tnum5 for i = 1, n do f(i, 0.5, 1, 1.5, 2) end return n end
+function call_tnum6(n) local f = tnum6 for i = 1, n do f(i, 0.5, 1, 1.5, 2, 2.5) end return n end
+
+--Lua -> C++: a hot loop made of calls to bound functions (FFI calls when built against LuaJIT)
+
+function call_heavy(n)
+	local f2, f4 = num2, num4
+	local s = 0
+	for i = 1, n do s = s + f2(i, 0.5) - f4(i, 0.5, s, 0.001) end
+	return n
+end
+
+function call_heavy_wrapper(n)
+	local f2, f4 = wnum2, wnum4
+	local s = 0
+	for i = 1, n do s = s + f2(i, 0.5) - f4(i, 0.5, s, 0.001) end
+	return n
+end
+
+--Lua -> C++: overloaded dispatch, always hits the last of N candidates
+
+function call_ovl2(n) local f = ovl2 for i = 1, n do f(i) end return n end
+function call_ovl4(n) local f = ovl4 for i = 1, n do f(i, 1, 2) end return n end
+function call_ovl8(n) local f = ovl8 for i = 1, n do f(i, 1, 2, 3, 4, 5, 6) end return n end
+
+--Lua -> C++: methods
+
+function call_method0(n) local o = Counter.new(0) for i = 1, n do o:Get() end return n end
+function call_method1(n) local o = Counter.new(0) for i = 1, n do o:Add(1) end return n end
+function call_method2(n) local o = Counter.new(0) for i = 1, n do o:Add2(1, 2) end return n end
+
+--Constructors (includes collecting every object that was created)
+
+function construct(n)
+	local ctor = Counter.new
+	for i = 1, n do local o = ctor(i) end
+	collectgarbage()
+	return n
+end
+
+function construct_in_place(n)
+	local ctor = InPlaceCounter.new
+	for i = 1, n do local o = ctor(i) end
+	collectgarbage()
+	return n
+end
+
+--Objects are dropped in batches smaller than the pool, so steady state construction is served from the pool
+function construct_pooled(n)
+	local ctor = PooledCounter.new
+	for i = 1, n do local o = ctor(i) if i % 512 == 0 then collectgarbage() end end
+	collectgarbage()
+	return n
+end
+
+--Member variables
+
+function member_get(n) local o = Counter.new(0) for i = 1, n do o.Value.get() end return n end
+--The setter takes the value as its only argument (o.Value.set, not o.Value:set), check it was really stored
+function member_set(n)
+	local o = Counter.new(0)
+	for i = 1, n do o.Value.set(i) end
+	if o.Value.get() ~= n then error("member_set stored " .. tostring(o.Value.get()) .. " instead of " .. n) end
+	return n
+end
+
+--Raw baseline objects are plain userdata, so they expose the member through accessor methods
+function member_get_raw(n) local o = Counter.new(0) for i = 1, n do o:GetValue() end return n end
+function member_set_raw(n) local o = Counter.new(0) for i = 1, n do o:SetValue(i) end return n end
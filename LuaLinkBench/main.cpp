@@ -0,0 +1,403 @@
+//
+//  main.cpp
+//  LuaLinkBench
+//
+//  Measures the overhead of the LuaLink binding layer against hand-written
+//  Lua C API code doing the same work. Results are written as JSON.
+//
+//  Usage: LuaLinkBench [--script bench.lua] [--iterations N] [--samples N]
+//                      [--filter substring] [--out results.json]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define LUALINK_DEFINE
+#include "LuaLink"
+#include "Bench.h"
+
+using namespace std;
+using namespace LuaLink;
+
+#ifndef LUALINK_BENCH_SCRIPT
+#define LUALINK_BENCH_SCRIPT "bench.lua"
+#endif
+
+namespace {
+    //A benchmark case runs the same operation n times through LuaLink and through the raw baseline
+    struct BenchCase {
+        string name;
+        function<void(int)> lualink;
+        function<void(int)> raw;
+        int divisor; //Cases that take microseconds per operation run iterations / divisor times (0 runs all of them)
+    };
+
+    struct BenchResult {
+        string name;
+        double lualinkMedian, lualinkMin;
+        double rawMedian, rawMin;
+    };
+
+    //C++ -> Lua calls with sizeof...(I) integer arguments
+
+    template<int... I>
+    void LuaLinkCallFunction(LuaScript& script, const char* name, int n)
+    {
+        for(int i = 0; i < n; ++i)
+            script.CallFunction<int>(name, (I + 1)...);
+    }
+
+    template<int... I>
+    void LuaLinkCallMethod(LuaScript& script, const char* name, int n)
+    {
+        for(int i = 0; i < n; ++i)
+            script.CallMethod<int>("M", name, (I + 1)...);
+    }
+
+    template<int... I>
+    void RawCallFunction(lua_State* L, const char* name, int n)
+    {
+        for(int i = 0; i < n; ++i){
+            lua_getglobal(L, name);
+            int expand[] = { 0, (lua_pushinteger(L, I + 1), 0)... };
+            (void)expand;
+            if(lua_pcall(L, sizeof...(I), 1, 0) != 0)
+                throw runtime_error(lua_tostring(L, -1));
+            int isnum;
+            lua_tointegerx(L, -1, &isnum);
+            lua_pop(L, 1);
+        }
+    }
+
+    template<int... I>
+    void RawCallMethod(lua_State* L, const char* name, int n)
+    {
+        for(int i = 0; i < n; ++i){
+            lua_getglobal(L, "M");
+            lua_getfield(L, -1, name);
+            int expand[] = { 0, (lua_pushinteger(L, I + 1), 0)... };
+            (void)expand;
+            if(lua_pcall(L, sizeof...(I), 1, 0) != 0)
+                throw runtime_error(lua_tostring(L, -1));
+            int isnum;
+            lua_tointegerx(L, -1, &isnum);
+            lua_pop(L, 2);
+        }
+    }
+
+    //Optional hooks that aren't defined: exceptions vs TryCallFunction, the baseline only checks for nil
+
+    void LuaLinkCallMissingThrow(LuaScript& script, int n)
+    {
+        for(int i = 0; i < n; ++i){
+            try { script.CallFunction<int>("missing_hook", i); }
+            catch(const LuaCallException&) {}
+        }
+    }
+
+    void LuaLinkCallMissingTry(LuaScript& script, int n)
+    {
+        for(int i = 0; i < n; ++i)
+            script.TryCallFunction<int>("missing_hook", i);
+    }
+
+    void RawCallMissing(lua_State* L, int n)
+    {
+        for(int i = 0; i < n; ++i){
+            lua_getglobal(L, "missing_hook");
+            if(lua_isnil(L, -1)){
+                lua_pop(L, 1);
+                continue;
+            }
+            lua_pushinteger(L, i);
+            lua_pcall(L, 1, 1, 0);
+            lua_pop(L, 1);
+        }
+    }
+
+    //One event per iteration, queued and delivered as a single batch
+    void LuaLinkDispatchEvents(LuaScript& script, int n)
+    {
+        for(int i = 0; i < n; ++i)
+            LuaEvents::Enqueue(1, i);
+        script.DispatchEvents();
+    }
+
+    void RawTriggerEvents(lua_State* L, int n)
+    {
+        for(int i = 0; i < n; ++i){
+            lua_getglobal(L, "EventHandler");
+            lua_getfield(L, -1, "TriggerEvent");
+            lua_pushstring(L, "GameStart");
+            lua_pushinteger(L, i);
+            if(lua_pcall(L, 2, 0, 0) != 0)
+                throw runtime_error(lua_tostring(L, -1));
+            lua_pop(L, 1);
+        }
+    }
+
+    //A request handler run in isolation: in a fresh sandbox of the shared state vs in a fresh lua_State
+
+    const char* s_RequestChunk =
+        "count = (count or 0) + 1\n"
+        "function handle(x) return x + count end\n";
+
+    void LuaLinkSandboxRequests(LuaScript& script, int n)
+    {
+        static LuaChunk chunk = script.LoadChunkString(s_RequestChunk, "=request");
+        
+        for(int i = 0; i < n; ++i){
+            LuaSandbox sandbox;
+            sandbox.Run(chunk);
+            sandbox.CallFunction<int>("handle", i);
+        }
+    }
+
+    void RawStateRequests(int n)
+    {
+        for(int i = 0; i < n; ++i){
+            lua_State* L = luaL_newstate();
+            luaL_openlibs(L);
+            if(luaL_loadstring(L, s_RequestChunk) != 0 || lua_pcall(L, 0, 0, 0) != 0)
+                throw runtime_error(lua_tostring(L, -1));
+            lua_getglobal(L, "handle");
+            lua_pushinteger(L, i);
+            if(lua_pcall(L, 1, 1, 0) != 0)
+                throw runtime_error(lua_tostring(L, -1));
+            lua_close(L);
+        }
+    }
+
+    //Lua -> C++ cases run their loop inside Lua, we call the driving function once per sample
+
+    BenchCase LuaLoop(LuaScript& script, lua_State* L, const string& name, const char* fn, const char* rawFn)
+    {
+        BenchCase c;
+        c.name = name;
+        c.divisor = 0;
+        c.lualink = [&script, fn](int n) { script.CallFunction<int>(fn, n); };
+        c.raw = [L, rawFn](int n) {
+            lua_getglobal(L, rawFn);
+            lua_pushinteger(L, n);
+            if(lua_pcall(L, 1, 1, 0) != 0)
+                throw runtime_error(lua_tostring(L, -1));
+            lua_pop(L, 1);
+        };
+        return c;
+    }
+
+    vector<BenchCase> CreateCases(LuaScript& script, lua_State* L)
+    {
+        vector<BenchCase> cases;
+
+        //CallFunction / CallMethod with 0-8 arguments
+        cases.push_back({ "call_function/0", [&](int n){ LuaLinkCallFunction<>(script, "f0", n); }, [=](int n){ RawCallFunction<>(L, "f0", n); } });
+        cases.push_back({ "call_function/1", [&](int n){ LuaLinkCallFunction<0>(script, "f1", n); }, [=](int n){ RawCallFunction<0>(L, "f1", n); } });
+        cases.push_back({ "call_function/2", [&](int n){ LuaLinkCallFunction<0,1>(script, "f2", n); }, [=](int n){ RawCallFunction<0,1>(L, "f2", n); } });
+        cases.push_back({ "call_function/3", [&](int n){ LuaLinkCallFunction<0,1,2>(script, "f3", n); }, [=](int n){ RawCallFunction<0,1,2>(L, "f3", n); } });
+        cases.push_back({ "call_function/4", [&](int n){ LuaLinkCallFunction<0,1,2,3>(script, "f4", n); }, [=](int n){ RawCallFunction<0,1,2,3>(L, "f4", n); } });
+        cases.push_back({ "call_function/5", [&](int n){ LuaLinkCallFunction<0,1,2,3,4>(script, "f5", n); }, [=](int n){ RawCallFunction<0,1,2,3,4>(L, "f5", n); } });
+        cases.push_back({ "call_function/6", [&](int n){ LuaLinkCallFunction<0,1,2,3,4,5>(script, "f6", n); }, [=](int n){ RawCallFunction<0,1,2,3,4,5>(L, "f6", n); } });
+        cases.push_back({ "call_function/7", [&](int n){ LuaLinkCallFunction<0,1,2,3,4,5,6>(script, "f7", n); }, [=](int n){ RawCallFunction<0,1,2,3,4,5,6>(L, "f7", n); } });
+        cases.push_back({ "call_function/8", [&](int n){ LuaLinkCallFunction<0,1,2,3,4,5,6,7>(script, "f8", n); }, [=](int n){ RawCallFunction<0,1,2,3,4,5,6,7>(L, "f8", n); } });
+
+        cases.push_back({ "call_function/missing_throw", [&](int n){ LuaLinkCallMissingThrow(script, n); }, [=](int n){ RawCallMissing(L, n); } });
+        cases.push_back({ "call_function/missing_try", [&](int n){ LuaLinkCallMissingTry(script, n); }, [=](int n){ RawCallMissing(L, n); } });
+        cases.push_back({ "call_function/try/2", [&](int n){ for(int i = 0; i < n; ++i) script.TryCallFunction<int>("f2", 1, 2); }, [=](int n){ RawCallFunction<0,1>(L, "f2", n); } });
+
+        cases.push_back({ "call_method/0", [&](int n){ LuaLinkCallMethod<>(script, "f0", n); }, [=](int n){ RawCallMethod<>(L, "f0", n); } });
+        cases.push_back({ "call_method/1", [&](int n){ LuaLinkCallMethod<0>(script, "f1", n); }, [=](int n){ RawCallMethod<0>(L, "f1", n); } });
+        cases.push_back({ "call_method/2", [&](int n){ LuaLinkCallMethod<0,1>(script, "f2", n); }, [=](int n){ RawCallMethod<0,1>(L, "f2", n); } });
+        cases.push_back({ "call_method/3", [&](int n){ LuaLinkCallMethod<0,1,2>(script, "f3", n); }, [=](int n){ RawCallMethod<0,1,2>(L, "f3", n); } });
+        cases.push_back({ "call_method/4", [&](int n){ LuaLinkCallMethod<0,1,2,3>(script, "f4", n); }, [=](int n){ RawCallMethod<0,1,2,3>(L, "f4", n); } });
+        cases.push_back({ "call_method/5", [&](int n){ LuaLinkCallMethod<0,1,2,3,4>(script, "f5", n); }, [=](int n){ RawCallMethod<0,1,2,3,4>(L, "f5", n); } });
+        cases.push_back({ "call_method/6", [&](int n){ LuaLinkCallMethod<0,1,2,3,4,5>(script, "f6", n); }, [=](int n){ RawCallMethod<0,1,2,3,4,5>(L, "f6", n); } });
+        cases.push_back({ "call_method/7", [&](int n){ LuaLinkCallMethod<0,1,2,3,4,5,6>(script, "f7", n); }, [=](int n){ RawCallMethod<0,1,2,3,4,5,6>(L, "f7", n); } });
+        cases.push_back({ "call_method/8", [&](int n){ LuaLinkCallMethod<0,1,2,3,4,5,6,7>(script, "f8", n); }, [=](int n){ RawCallMethod<0,1,2,3,4,5,6,7>(L, "f8", n); } });
+
+        //Events, CallMethod per event vs the batched event bus
+        cases.push_back({ "events/call_method", [&](int n){ for(int i = 0; i < n; ++i) script.CallMethod<void>("EventHandler", "TriggerEvent", "GameStart", i); }, [=](int n){ RawTriggerEvents(L, n); } });
+        cases.push_back({ "events/batch", [&](int n){ LuaLinkDispatchEvents(script, n); }, [=](int n){ RawTriggerEvents(L, n); } });
+
+        //Per-request isolation
+        cases.push_back({ "sandbox/request", [&](int n){ LuaLinkSandboxRequests(script, n); }, [](int n){ RawStateRequests(n); }, 100 });
+
+        //Lua -> C++ through FunctionWrapper
+        cases.push_back(LuaLoop(script, L, "function_wrapper/0", "call_cfn0", "call_cfn0"));
+        cases.push_back(LuaLoop(script, L, "function_wrapper/1", "call_cfn1", "call_cfn1"));
+        cases.push_back(LuaLoop(script, L, "function_wrapper/2", "call_cfn2", "call_cfn2"));
+        cases.push_back(LuaLoop(script, L, "function_wrapper/3", "call_cfn3", "call_cfn3"));
+        cases.push_back(LuaLoop(script, L, "function_wrapper/4", "call_cfn4", "call_cfn4"));
+        cases.push_back(LuaLoop(script, L, "function_wrapper/functor/2", "call_lfn2", "call_cfn2"));
+
+        //Numeric functions, checked (Register) vs trusted (RegisterTrusted) argument reads
+        cases.push_back(LuaLoop(script, L, "numeric/1", "call_num1", "call_num1"));
+        cases.push_back(LuaLoop(script, L, "numeric/2", "call_num2", "call_num2"));
+        cases.push_back(LuaLoop(script, L, "numeric/3", "call_num3", "call_num3"));
+        cases.push_back(LuaLoop(script, L, "numeric/4", "call_num4", "call_num4"));
+        cases.push_back(LuaLoop(script, L, "numeric/5", "call_num5", "call_num5"));
+        cases.push_back(LuaLoop(script, L, "numeric/6", "call_num6", "call_num6"));
+        cases.push_back(LuaLoop(script, L, "numeric_trusted/1", "call_tnum1", "call_tnum1"));
+        cases.push_back(LuaLoop(script, L, "numeric_trusted/2", "call_tnum2", "call_tnum2"));
+        cases.push_back(LuaLoop(script, L, "numeric_trusted/3", "call_tnum3", "call_tnum3"));
+        cases.push_back(LuaLoop(script, L, "numeric_trusted/4", "call_tnum4", "call_tnum4"));
+        cases.push_back(LuaLoop(script, L, "numeric_trusted/5", "call_tnum5", "call_tnum5"));
+        cases.push_back(LuaLoop(script, L, "numeric_trusted/6", "call_tnum6", "call_tnum6"));
+
+        //Tight loop calling two bound functions per iteration
+        cases.push_back(LuaLoop(script, L, "call_heavy", "call_heavy", "call_heavy"));
+        cases.push_back(LuaLoop(script, L, "call_heavy/wrapper", "call_heavy_wrapper", "call_heavy"));
+
+        //Lua -> C++ through LuaMethod (PushThisPointer)
+        cases.push_back(LuaLoop(script, L, "method/0", "call_method0", "call_method0"));
+        cases.push_back(LuaLoop(script, L, "method/1", "call_method1", "call_method1"));
+        cases.push_back(LuaLoop(script, L, "method/2", "call_method2", "call_method2"));
+
+        //Overloaded dispatch with N candidates
+        cases.push_back(LuaLoop(script, L, "overload_dispatch/2", "call_ovl2", "call_ovl2"));
+        cases.push_back(LuaLoop(script, L, "overload_dispatch/4", "call_ovl4", "call_ovl4"));
+        cases.push_back(LuaLoop(script, L, "overload_dispatch/8", "call_ovl8", "call_ovl8"));
+
+        //Constructor throughput
+        cases.push_back(LuaLoop(script, L, "constructor", "construct", "construct"));
+        cases.push_back(LuaLoop(script, L, "constructor/in_place", "construct_in_place", "construct_in_place"));
+        cases.push_back(LuaLoop(script, L, "constructor/pooled", "construct_pooled", "construct_pooled"));
+
+        //Member variable get/set
+        cases.push_back(LuaLoop(script, L, "member/get", "member_get", "member_get_raw"));
+        cases.push_back(LuaLoop(script, L, "member/set", "member_set", "member_set_raw"));
+
+        return cases;
+    }
+
+    //Returns nanoseconds per operation
+    double Measure(const function<void(int)>& fn, int iterations)
+    {
+        auto start = chrono::steady_clock::now();
+        fn(iterations);
+        auto stop = chrono::steady_clock::now();
+        return chrono::duration<double, nano>(stop - start).count() / iterations;
+    }
+
+    double Median(vector<double> v)
+    {
+        sort(v.begin(), v.end());
+        size_t mid = v.size() / 2;
+        return v.size() % 2 ? v[mid] : (v[mid - 1] + v[mid]) / 2;
+    }
+
+    BenchResult Run(const BenchCase& c, int iterations, int samples)
+    {
+        vector<double> lualink, raw;
+        
+        if(c.divisor > 1)
+            iterations = max(1, iterations / c.divisor);
+
+        //Warm up caches, the allocator and the Lua string table before measuring
+        Measure(c.lualink, iterations);
+        Measure(c.raw, iterations);
+
+        //Interleave samples so drift (frequency scaling, other load) affects both sides equally
+        for(int i = 0; i < samples; ++i){
+            lualink.push_back(Measure(c.lualink, iterations));
+            raw.push_back(Measure(c.raw, iterations));
+        }
+
+        BenchResult r;
+        r.name = c.name;
+        r.lualinkMedian = Median(lualink);
+        r.lualinkMin = *min_element(lualink.begin(), lualink.end());
+        r.rawMedian = Median(raw);
+        r.rawMin = *min_element(raw.begin(), raw.end());
+        return r;
+    }
+
+    void WriteJson(FILE* out, const vector<BenchResult>& results, int iterations, int samples)
+    {
+        fprintf(out, "{\n  \"lua_version\": %d,\n  \"iterations\": %d,\n  \"samples\": %d,\n  \"unit\": \"ns/op\",\n  \"results\": [\n",
+                (int)LUA_VERSION_NUM, iterations, samples);
+
+        for(size_t i = 0; i < results.size(); ++i){
+            const BenchResult& r = results[i];
+            fprintf(out, "    { \"name\": \"%s\", \"lualink\": %.2f, \"lualink_min\": %.2f, \"raw\": %.2f, \"raw_min\": %.2f, \"ratio\": %.3f }%s\n",
+                    r.name.c_str(), r.lualinkMedian, r.lualinkMin, r.rawMedian, r.rawMin,
+                    r.rawMedian > 0 ? r.lualinkMedian / r.rawMedian : 0.0,
+                    i + 1 < results.size() ? "," : "");
+        }
+
+        fprintf(out, "  ]\n}\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* scriptFile = LUALINK_BENCH_SCRIPT;
+    const char* filter = nullptr;
+    const char* outFile = nullptr;
+    int iterations = 200000;
+    int samples = 7;
+
+    for(int i = 1; i < argc; ++i){
+        if(i + 1 < argc && strcmp(argv[i], "--script") == 0)
+            scriptFile = argv[++i];
+        else if(i + 1 < argc && strcmp(argv[i], "--iterations") == 0)
+            iterations = max(1, atoi(argv[++i]));
+        else if(i + 1 < argc && strcmp(argv[i], "--samples") == 0)
+            samples = max(1, atoi(argv[++i]));
+        else if(i + 1 < argc && strcmp(argv[i], "--filter") == 0)
+            filter = argv[++i];
+        else if(i + 1 < argc && strcmp(argv[i], "--out") == 0)
+            outFile = argv[++i];
+        else{
+            cerr << "Usage: " << argv[0] << " [--script file] [--iterations N] [--samples N] [--filter substring] [--out file]" << endl;
+            return 1;
+        }
+    }
+
+    lua_State* L = nullptr;
+
+    try{
+        LuaScript luaScript(scriptFile);
+
+        luaScript.Load(InitBenchEnvironment, true, false);
+        luaScript.Initialize();
+
+        L = CreateRawBenchState(scriptFile);
+        if(!L)
+            throw runtime_error("Unable to create raw baseline state for " + string(scriptFile));
+
+        vector<BenchResult> results;
+        for(auto& c : CreateCases(luaScript, L)){
+            if(filter && c.name.find(filter) == string::npos)
+                continue;
+
+            results.push_back(Run(c, iterations, samples));
+            cerr << c.name << ": " << results.back().lualinkMedian << " ns/op (raw " << results.back().rawMedian << " ns/op)" << endl;
+        }
+
+        FILE* out = outFile ? fopen(outFile, "w") : stdout;
+        if(!out)
+            throw runtime_error("Unable to open " + string(outFile));
+
+        WriteJson(out, results, iterations, samples);
+
+        if(out != stdout)
+            fclose(out);
+    }
+    catch(std::exception& e){
+        cerr << endl << e.what() << endl;
+        if(L)
+            lua_close(L);
+        return 1;
+    }
+
+    lua_close(L);
+    return 0;
+}
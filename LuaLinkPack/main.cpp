@@ -0,0 +1,232 @@
+//
+//  main.cpp
+//  LuaLinkPack
+//
+//  Packs Lua modules into a bundle that LuaBundle maps at runtime, so require
+//  only loads the modules that are actually used. Chunks are precompiled with
+//  the Lua version this tool is built against, unless --source is given.
+//
+//  Usage: LuaLinkPack -o out.llb [--root dir] [--source] [--strip]
+//                     [--embed symbol] module.lua...
+//
+//  Module names are file paths relative to --root, without the .lua extension
+//  and with separators replaced by dots (a/b.lua -> a.b, a/init.lua -> a).
+//  --embed writes a C++ source file defining the bundle as a byte array
+//  instead (extern const unsigned char symbol[]; extern const size_t symbol_size;),
+//  to pass to LuaBundle::Attach.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "LuaBundle.hpp"
+
+using namespace std;
+using LuaLink::detail::BundleFormat;
+
+namespace {
+    struct Module {
+        string name;
+        string chunk;
+    };
+
+    string ModuleName(string path, const string& root)
+    {
+        replace(path.begin(), path.end(), '\\', '/');
+
+        if(!root.empty() && path.compare(0, root.size(), root) == 0){
+            path.erase(0, root.size());
+            if(!path.empty() && path[0] == '/')
+                path.erase(0, 1);
+        }
+
+        if(path.size() > 4 && path.compare(path.size() - 4, 4, ".lua") == 0)
+            path.erase(path.size() - 4);
+        if(path.size() > 5 && path.compare(path.size() - 5, 5, "/init") == 0)
+            path.erase(path.size() - 5);
+
+        replace(path.begin(), path.end(), '/', '.');
+        return path;
+    }
+
+    string ReadFile(const string& path)
+    {
+        ifstream file(path.c_str(), ios::in | ios::binary);
+        if(!file)
+            throw runtime_error("Unable to open " + path);
+
+        stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    int WriteChunk(lua_State*, const void* p, size_t size, void* ud)
+    {
+        static_cast<string*>(ud)->append(static_cast<const char*>(p), size);
+        return 0;
+    }
+
+    //Parses the module and dumps its bytecode, so syntax errors show up at build time either way
+    string Compile(lua_State* L, const string& path, bool isStripped)
+    {
+        if(luaL_loadfile(L, path.c_str()) != 0){
+            string msg(lua_tostring(L, -1));
+            lua_pop(L, 1);
+            throw runtime_error(msg);
+        }
+
+        string chunk;
+#if LUA_VERSION_NUM >= 503
+        lua_dump(L, WriteChunk, &chunk, isStripped ? 1 : 0);
+#else
+        (void)isStripped; //Lua 5.2 and LuaJIT always keep debug information in lua_dump
+        lua_dump(L, WriteChunk, &chunk);
+#endif
+        lua_pop(L, 1);
+        return chunk;
+    }
+
+    void AppendU32(string& out, size_t value)
+    {
+        if(value > 0xFFFFFFFFu)
+            throw runtime_error("Bundle exceeds 4 GB");
+
+        for(int i = 0; i < 4; ++i)
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+
+    string Pack(const vector<Module>& modules, bool isPrecompiled)
+    {
+        unsigned int flags = isPrecompiled ? BundleFormat::Precompiled : 0;
+#ifdef LUAJIT_VERSION
+        flags |= BundleFormat::LuaJIT;
+#endif
+
+        string out(BundleFormat::Magic(), 8);
+        AppendU32(out, BundleFormat::Version);
+        AppendU32(out, LUA_VERSION_NUM);
+        AppendU32(out, flags);
+        AppendU32(out, modules.size());
+
+        size_t offset = BundleFormat::HeaderSize + modules.size() * BundleFormat::EntrySize;
+        for(auto& m : modules){
+            AppendU32(out, offset);
+            AppendU32(out, m.name.size());
+            AppendU32(out, offset + m.name.size());
+            AppendU32(out, m.chunk.size());
+            offset += m.name.size() + m.chunk.size();
+        }
+
+        for(auto& m : modules){
+            out += m.name;
+            out += m.chunk;
+        }
+
+        return out;
+    }
+
+    void WriteEmbedded(FILE* out, const string& bundle, const string& symbol)
+    {
+        fprintf(out, "//Generated by LuaLinkPack, pass to LuaBundle::Attach\n#include <cstddef>\n\n");
+        fprintf(out, "extern const unsigned char %s[];\nextern const size_t %s_size;\n\n", symbol.c_str(), symbol.c_str());
+        fprintf(out, "const unsigned char %s[] = {", symbol.c_str());
+
+        for(size_t i = 0; i < bundle.size(); ++i)
+            fprintf(out, "%s%u,", i % 16 ? " " : "\n    ", static_cast<unsigned char>(bundle[i]));
+
+        fprintf(out, "\n};\n\nconst size_t %s_size = sizeof(%s);\n", symbol.c_str(), symbol.c_str());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* outFile = nullptr;
+    string root, symbol;
+    bool isSource = false, isStripped = false;
+    vector<string> files;
+
+    for(int i = 1; i < argc; ++i){
+        if(i + 1 < argc && strcmp(argv[i], "-o") == 0)
+            outFile = argv[++i];
+        else if(i + 1 < argc && strcmp(argv[i], "--root") == 0)
+            root = argv[++i];
+        else if(i + 1 < argc && strcmp(argv[i], "--embed") == 0)
+            symbol = argv[++i];
+        else if(strcmp(argv[i], "--source") == 0)
+            isSource = true;
+        else if(strcmp(argv[i], "--strip") == 0)
+            isStripped = true;
+        else if(argv[i][0] != '-')
+            files.push_back(argv[i]);
+        else{
+            outFile = nullptr;
+            break;
+        }
+    }
+
+    if(!outFile || files.empty()){
+        cerr << "Usage: " << argv[0] << " -o out.llb [--root dir] [--source] [--strip] [--embed symbol] module.lua..." << endl;
+        return 1;
+    }
+
+    replace(root.begin(), root.end(), '\\', '/');
+
+    lua_State* L = luaL_newstate();
+    if(!L){
+        cerr << "Unable to create lua_State" << endl;
+        return 1;
+    }
+
+    try{
+        vector<Module> modules;
+        for(auto& path : files){
+            Module m;
+            m.name = ModuleName(path, root);
+            m.chunk = isSource ? ReadFile(path) : Compile(L, path, isStripped);
+
+            //Sources are still parsed here, so syntax errors fail the build
+            if(isSource){
+                Compile(L, path, false);
+                if(!m.chunk.empty() && m.chunk[0] == '\033')
+                    throw runtime_error(path + " is precompiled, it can't be packed with --source");
+            }
+
+            modules.push_back(m);
+        }
+
+        //Sorted by name, LuaBundle finds modules with a binary search
+        sort(modules.begin(), modules.end(), [](const Module& a, const Module& b){ return a.name < b.name; });
+        for(size_t i = 1; i < modules.size(); ++i)
+            if(modules[i].name == modules[i - 1].name)
+                throw runtime_error("Module " + modules[i].name + " is packed twice");
+
+        string bundle = Pack(modules, !isSource);
+
+        FILE* out = fopen(outFile, symbol.empty() ? "wb" : "w");
+        if(!out)
+            throw runtime_error("Unable to open " + string(outFile));
+
+        if(symbol.empty())
+            fwrite(bundle.data(), 1, bundle.size(), out);
+        else
+            WriteEmbedded(out, bundle, symbol);
+
+        fclose(out);
+        cerr << "Packed " << modules.size() << " modules (" << bundle.size() << " bytes) into " << outFile << endl;
+    }
+    catch(std::exception& e){
+        cerr << e.what() << endl;
+        lua_close(L);
+        return 1;
+    }
+
+    lua_close(L);
+    return 0;
+}
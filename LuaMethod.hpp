@@ -26,6 +26,7 @@ namespace LuaLink
     namespace detail {
         // Callback wrappers
         template<typename ClassT, typename _RetType, typename... _ArgTypes> struct MethodWrapper;
+        template<typename ClassT, typename _RetType, typename... _ArgTypes> struct TrustedMethodWrapper;
     }
 
 	template<typename ClassT>
@@ -36,9 +37,15 @@ namespace LuaLink
         // // Add a C++ member function to the appropriate lookup table
         static void Register(_RetType(ClassT::*pFunc)(_ArgTypes...), const char* name);
         
+		template<typename _RetType, typename... _ArgTypes>
+        // // Registers a member function that reads its arguments without checks, see LuaFunction::RegisterTrusted
+        static void RegisterTrusted(_RetType(ClassT::*pFunc)(_ArgTypes...), const char* name);
+        
 	private:
         template<typename T, typename _RetType, typename... _ArgTypes>
         friend struct detail::MethodWrapper;
+        template<typename T, typename _RetType, typename... _ArgTypes>
+        friend struct detail::TrustedMethodWrapper;
 		friend class LuaClass<ClassT>; //LuaClass<ClassT> needs access to Commit, rather befriend LuaClass<ClassT> than expose Commit to everything
 	
 		typedef void(ClassT::*Unsafe_MethodType)();
@@ -49,15 +56,11 @@ namespace LuaLink
 		struct Unsafe_MethodWrapper;
 	
 		//Contains all registered member functions, is flushed after functions are pushed to Lua environment
+		//Once pushed, each closure carries its callbacks in a full userdata upvalue
 		static std::map<const char*, std::vector<Unsafe_MethodWrapper>, detail::CStrCmp > s_LuaFunctionMap;
-
-		//* Contains all registered member functions
-		//* Is filled when functions are pushed to Lua environment
-		//* Used to retrieve callbacks on Lua function calls
-		static std::vector<Unsafe_MethodWrapper> s_LuaFunctionTable;
 	
 		// // Pushes all registered member functions to the Lua environment
-		static void Commit(lua_State* pLuaState, int tablePosOnStack);
+		static void Commit(lua_State* pLuaState, int tablePosOnStack, const char* className);
 	
 		// // Retrieves the this pointer from the table on the bottom of the stack
 		static void PushThisPointer(lua_State* L);
@@ -65,8 +68,9 @@ namespace LuaLink
 		// // Tries out all overloads until it finds an overload that matches the arguments used in the Lua call
 		static int OverloadDispatch(lua_State* L);
 		
+		template<typename... _ArgTypes>
 		// // Common code in all MethodWrappers, returns pointer to pointer to object to call member function on
-		static ClassT** GetObjectAndVerifyStackSize(lua_State* L, int nrOfArgs);
+		static ClassT** GetObjectAndVerifyStackSize(lua_State* L);
 	
 		//Disable default constructor, destructor, copy constructor & assignment operator
 		LuaMethod(void) = delete;
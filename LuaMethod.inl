@@ -19,6 +19,7 @@
 #include "TemplateUtil.h"
 #include <vector>
 #include <map>
+#include <new>
 
 namespace LuaLink
 {
@@ -50,23 +51,33 @@ namespace LuaLink
 	}
 
 	template<typename ClassT>
-	// // Pushes all registered member functions to the Lua environment
-	void LuaMethod<ClassT>::Commit(lua_State* pLuaState, int tablePosOnStack)
+	template<typename _RetType, typename... _ArgTypes>
+	void LuaMethod<ClassT>::RegisterTrusted(_RetType(ClassT::*pFunc)(_ArgTypes...), const char* name)
 	{
-		if(!s_LuaFunctionTable.empty())
-			s_LuaFunctionTable.clear();
+		auto it = s_LuaFunctionMap.find(name);
+		if( it == s_LuaFunctionMap.end() )
+			it = s_LuaFunctionMap.insert(make_pair(name, std::vector<Unsafe_MethodWrapper>() ) ).first;
 
+		//Overloads are dispatched through the checked wrapper
+        it->second.push_back(Unsafe_MethodWrapper(detail::MethodWrapper<ClassT, _RetType, _ArgTypes...>::execute,
+                                                  detail::TrustedMethodWrapper<ClassT, _RetType, _ArgTypes...>::execute,
+                                                  reinterpret_cast<Unsafe_MethodType>(pFunc)));
+	}
+
+	template<typename ClassT>
+	// // Pushes all registered member functions to the Lua environment
+	void LuaMethod<ClassT>::Commit(lua_State* pLuaState, int tablePosOnStack, const char* className)
+	{
 		for(auto& elem : s_LuaFunctionMap)
 		{
 			//No overloading
 			if(elem.second.size() == 1){
-				s_LuaFunctionTable.push_back(elem.second[0]); //Add function to the lookup table
-
 				lua_pushstring(pLuaState, elem.first ); //Push function name
 
-				//Push index of function in lookup table & wrapper as closure
-				lua_pushinteger(pLuaState, s_LuaFunctionTable.size() - 1);
-				lua_pushcclosure(pLuaState, elem.second[0].pWrapperSingle, 1);
+				//Push member function pointer (does not fit in a light userdata), name for the tracer & wrapper as closure
+				new (lua_newuserdata(pLuaState, sizeof(Unsafe_MethodType))) Unsafe_MethodType(elem.second[0].pFunc);
+				detail::Trace::PushName(pLuaState, className, elem.first);
+				lua_pushcclosure(pLuaState, elem.second[0].pWrapperSingle, 2);
 				
 				lua_settable(pLuaState, tablePosOnStack); //Add entry to the Lua table
 				continue;
@@ -74,18 +85,10 @@ namespace LuaLink
 
 			//This function needs to be overloaded =>
 
-			//Move functions to lookup table
-			size_t startIdx = s_LuaFunctionTable.size();
-			size_t endIdx = startIdx + elem.second.size();
-
-			std::move(elem.second.begin(), elem.second.end(), std::insert_iterator<std::vector<Unsafe_MethodWrapper>>(s_LuaFunctionTable, s_LuaFunctionTable.end()));
-		
 			lua_pushstring(pLuaState, elem.first); //Push function name
 
-			//Push start and end indices of functions in lookup table (endIdx is one past last function, like .end() iterators)
-			lua_pushinteger(pLuaState, startIdx);
-			lua_pushinteger(pLuaState, endIdx);
-
+			detail::LuaFunction::PushCallables(pLuaState, elem.second); //Push overloads
+			detail::Trace::PushName(pLuaState, className, elem.first); //Push name for the tracer
 			lua_pushcclosure(pLuaState, OverloadDispatch, 2); //Push closure
 
 			lua_settable(pLuaState, tablePosOnStack); //Set table
@@ -106,6 +109,9 @@ namespace LuaLink
 	
 		if(lua_isuserdata(L, -1) == 0)
 			luaL_error(L, "Calling a nonstatic member function requires a reference to an object");
+		
+		if(*static_cast<ClassT**>(lua_touserdata(L, -1)) == nullptr)
+			luaL_error(L, "Calling a nonstatic member function on an object that has been destroyed or detached");
 	
 		lua_remove(L, 1); //Remove 'self table' from stack
 	}
@@ -114,15 +120,18 @@ namespace LuaLink
 	// Tries out all overloads until it finds an overload that matches the arguments used in the Lua call
 	int LuaMethod<ClassT>::OverloadDispatch(lua_State* L)
 	{
-		//Retrieve range in lookup table where overloads are located
-		auto startIdx = static_cast<int>( lua_tointeger( L, lua_upvalueindex(1) ) );
-		auto endIdx =	static_cast<int>( lua_tointeger( L, lua_upvalueindex(2) ) );
+		detail::Metrics::CountBindingCall();
+		detail::Trace::Scope traceScope(L, lua_upvalueindex(2));
+		
+		//Retrieve overloads from our upvalue
+		size_t count = 0;
+		auto pOverloads = detail::LuaFunction::ToCallables<Unsafe_MethodWrapper>(L, lua_upvalueindex(1), count);
 
 		PushThisPointer(L);
 
 		//Try all functions
-		for(auto i = startIdx; i < endIdx; ++i){
-			int ret = s_LuaFunctionTable[i].pWrapper(L, s_LuaFunctionTable[i].pFunc, LuaFunction::OverloadedErrorHandling);
+		for(size_t i = 0; i < count; ++i){
+			int ret = pOverloads[i].pWrapper(L, pOverloads[i].pFunc, LuaFunction::OverloadedErrorHandling);
 		
 			if(ret < 0)
 				continue;
@@ -135,11 +144,12 @@ namespace LuaLink
 	}
 
 	template<typename ClassT>
+	template<typename... _ArgTypes>
 	// // Common code in all MethodWrappers, returns pointer to pointer to object to call member function on
-	ClassT** LuaMethod<ClassT>::GetObjectAndVerifyStackSize(lua_State* L, int nrOfArgs)
+	ClassT** LuaMethod<ClassT>::GetObjectAndVerifyStackSize(lua_State* L)
 	{
-		int argc = lua_gettop(L);
-		if(argc != nrOfArgs + 1) //stack should contain 'this pointer' + args
+		//stack should contain args + 'this pointer'
+		if(!detail::CheckArgCount<_ArgTypes...>(L, lua_gettop(L) - 1))
 			return nullptr;
 	
 		auto ppObj = static_cast<ClassT**>(lua_touserdata(L, -1) ); //Retrieve internal object
@@ -149,7 +159,7 @@ namespace LuaLink
 	
 	// CALLBACK WRAPPERS
 
-	#define GET_THIS(ARGC) auto ppObj = LuaMethod<ClassT>::GetObjectAndVerifyStackSize(pLuaState, ARGC); \
+	#define GET_THIS(...) auto ppObj = LuaMethod<ClassT>::template GetObjectAndVerifyStackSize<__VA_ARGS__>(pLuaState); \
         if(!ppObj) \
             return onArgError(pLuaState, 0); \
         bool isOk = true; \
@@ -158,8 +168,10 @@ namespace LuaLink
 	#define DO_LUACALLBACK(CBTYPE,...) ((*ppObj)->*(reinterpret_cast<CBTYPE>(fn)))( __VA_ARGS__ )
 
 	#define EXECUTE_V2 static int execute(lua_State* L){ \
+		Metrics::CountBindingCall(); \
+		Trace::Scope traceScope(L, lua_upvalueindex(2)); \
 		LuaMethod<ClassT>::PushThisPointer(L);\
-		return execute(L, LuaMethod<ClassT>::s_LuaFunctionTable[static_cast<unsigned int>(lua_tointeger( L, lua_upvalueindex(1) ) )].pFunc, ::LuaLink::LuaFunction::DefaultErrorHandling);}
+		return execute(L, *static_cast<typename LuaMethod<ClassT>::Unsafe_MethodType*>(lua_touserdata( L, lua_upvalueindex(1) )), ::LuaLink::LuaFunction::DefaultErrorHandling);}
     
     namespace detail {
         
@@ -171,16 +183,16 @@ namespace LuaLink
             
             static int execute(lua_State* pLuaState, typename LuaMethod<ClassT>::Unsafe_MethodType fn, ArgErrorCbType onArgError)
             {
-                GET_THIS(sizeof...(_ArgTypes))
+                GET_THIS(_ArgTypes...)
                 
                 int errnum = 0;
                 auto tpl = build_tuple_from_lua_stack<_ArgTypes...>::execute(pLuaState, 1, isOk, onArgError, errnum);
                 if(!isOk)
                     return errnum;
                 
-                LuaStack::pushVariable( pLuaState, call_mem(reinterpret_cast<CbType>(fn), *ppObj, tpl) );
+                Results<_RetType>::push( pLuaState, call_mem(reinterpret_cast<CbType>(fn), *ppObj, tpl) );
                 
-                return 1;
+                return ResultCount<_RetType>::value;
             }
             
             EXECUTE_V2
@@ -194,7 +206,7 @@ namespace LuaLink
             
             static int execute(lua_State* pLuaState, typename LuaMethod<ClassT>::Unsafe_MethodType fn, ArgErrorCbType onArgError)
             {
-                GET_THIS(sizeof...(_ArgTypes))
+                GET_THIS(_ArgTypes...)
                 
                 int errnum = 0;
                 auto tpl = build_tuple_from_lua_stack<_ArgTypes...>::execute(pLuaState, 1, isOk, onArgError, errnum);
@@ -215,7 +227,7 @@ namespace LuaLink
         {
             static int execute(lua_State* pLuaState, typename LuaMethod<ClassT>::Unsafe_MethodType fn, ArgErrorCbType onArgError)
             {
-                GET_THIS(0);
+                GET_THIS();
                 DO_LUACALLBACK( void(ClassT::*)(void) );
                 return 0;
             }
@@ -229,13 +241,58 @@ namespace LuaLink
         {
             static int execute(lua_State* pLuaState, typename LuaMethod<ClassT>::Unsafe_MethodType fn, ArgErrorCbType onArgError)
             {
-                GET_THIS(0)
-                LuaStack::pushVariable(	pLuaState, DO_LUACALLBACK( _RetType(ClassT::*)(void) ) );
-                return 1;
+                GET_THIS()
+                Results<_RetType>::push(	pLuaState, DO_LUACALLBACK( _RetType(ClassT::*)(void) ) );
+                return ResultCount<_RetType>::value;
             }
             
             EXECUTE_V2
         };
+        
+        //trusted, the object itself is still verified, only argument checks are skipped
+        template<typename ClassT, typename _RetType, typename... _ArgTypes>
+        struct TrustedMethodWrapper
+        {
+            typedef _RetType(ClassT::*CbType)(_ArgTypes...);
+            
+            static int execute(lua_State* L)
+            {
+#ifdef LUALINK_CHECK_TRUSTED
+                return MethodWrapper<ClassT, _RetType, _ArgTypes...>::execute(L);
+#else
+                Metrics::CountBindingCall();
+                Trace::Scope traceScope(L, lua_upvalueindex(2));
+                LuaMethod<ClassT>::PushThisPointer(L);
+                auto pObj = *static_cast<ClassT**>(lua_touserdata(L, -1));
+                auto fn = reinterpret_cast<CbType>(*static_cast<typename LuaMethod<ClassT>::Unsafe_MethodType*>(lua_touserdata( L, lua_upvalueindex(1) )));
+                
+                Results<_RetType>::push( L, call_mem_trusted(L, fn, pObj) );
+                return ResultCount<_RetType>::value;
+#endif
+            }
+        };
+        
+        template<typename ClassT, typename... _ArgTypes>
+        struct TrustedMethodWrapper<ClassT, void, _ArgTypes...>
+        {
+            typedef void(ClassT::*CbType)(_ArgTypes...);
+            
+            static int execute(lua_State* L)
+            {
+#ifdef LUALINK_CHECK_TRUSTED
+                return MethodWrapper<ClassT, void, _ArgTypes...>::execute(L);
+#else
+                Metrics::CountBindingCall();
+                Trace::Scope traceScope(L, lua_upvalueindex(2));
+                LuaMethod<ClassT>::PushThisPointer(L);
+                auto pObj = *static_cast<ClassT**>(lua_touserdata(L, -1));
+                auto fn = reinterpret_cast<CbType>(*static_cast<typename LuaMethod<ClassT>::Unsafe_MethodType*>(lua_touserdata( L, lua_upvalueindex(1) )));
+                
+                call_mem_trusted(L, fn, pObj);
+                return 0;
+#endif
+            }
+        };
     }
     
 #undef GET_THIS
@@ -243,9 +300,6 @@ namespace LuaLink
 #undef DO_LUACALLBACK
 #undef EXECUTE_V2
     
-    template<typename ClassT>
-    std::vector<typename LuaMethod<ClassT>::Unsafe_MethodWrapper> LuaMethod<ClassT>::s_LuaFunctionTable;
-    
     template<typename ClassT>
     std::map<const char*, std::vector<typename LuaMethod<ClassT>::Unsafe_MethodWrapper>, detail::CStrCmp > LuaMethod<ClassT>::s_LuaFunctionMap;
     
@@ -0,0 +1,159 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Number of counters per thread, every function called through CallFunction/CallMethod and every class takes two
+#ifndef LUALINK_MAX_METRICS
+#define LUALINK_MAX_METRICS 1024
+#endif
+
+namespace LuaLink
+{
+	enum class LuaMetricsFormat
+	{
+		Prometheus,	//Text exposition format, e.g. for node_exporter's textfile collector
+		Json
+	};
+
+	struct LuaCallMetrics
+	{
+		unsigned long long Calls;
+		unsigned long long Errors; //Calls that failed, including functions that weren't found and return type mismatches
+	};
+
+	// // Runtime metrics of the script host, see LuaScript::GetMetrics and LuaScript::GetProcessMetrics
+	struct LuaMetricsSnapshot
+	{
+		std::map<std::string, LuaCallMetrics> Calls; //CallFunction/CallMethod/TryCall*, by "function" or "Table.function"
+		std::map<std::string, long long> LiveObjects; //Objects wrapped for Lua by class (constructed from Lua or pushed from C++)
+		unsigned long long BindingCalls; //Lua -> C++ calls of bound functions, methods and constructors (not FFI calls under LuaJIT)
+		unsigned long long Exceptions; //LuaLoadException/LuaCallException/LuaTimeoutException thrown
+		unsigned long long GCCycles;
+		size_t HeapBytes;
+		size_t PeakHeapBytes;
+		int PeakCallDepth; //Nesting of calls into Lua (C++ -> Lua -> C++ -> Lua counts 2)
+		int PeakStackSize; //Slots on the Lua stack when a call into Lua started
+	};
+
+	// // Exports metrics snapshots
+	class LuaMetrics
+	{
+	public:
+		static std::string Format(const LuaMetricsSnapshot& snapshot, LuaMetricsFormat format);
+
+		// // Replaces the file (written next to it first, then renamed), returns false if it couldn't be written
+		static bool WriteFile(const char* filename, const LuaMetricsSnapshot& snapshot, LuaMetricsFormat format);
+
+		// // Hands the formatted snapshot to pfnExport
+		static void Export(const LuaMetricsSnapshot& snapshot, LuaMetricsFormat format, void(*pfnExport)(const std::string& text, void* pUserData), void* pUserData = nullptr);
+
+	private:
+		//Disable default constructor, destructor, copy constructor & assignment operator
+		LuaMetrics(void) = delete;
+		~LuaMetrics(void) = delete;
+		LuaMetrics(const LuaMetrics& src) = delete;
+		LuaMetrics& operator=(const LuaMetrics& src) = delete;
+	};
+
+	namespace detail {
+		namespace Metrics {
+			//Fixed counters, pairs of counters for calls and classes follow
+			enum Counter
+			{
+				BindingCalls,
+				Exceptions,
+				GCCycles,
+				OtherCalls, //Shared by calls and classes that didn't get their own pair
+				OtherCallErrors,
+				OtherObjectsWrapped,
+				OtherObjectsReleased,
+				NrOfCounters
+			};
+
+			// Counters of one thread, only that thread writes them
+			struct ThreadCounters
+			{
+				ThreadCounters(void);
+
+				// Recently called name, matched by address and then by value, since the buffer behind an address may be reused
+				struct CachedCall
+				{
+					const char* pTableName;
+					const char* pFunctionName;
+					std::string TableName;
+					std::string FunctionName;
+					int Counter; //-1 while unused
+				};
+
+				std::atomic<unsigned long long> Values[LUALINK_MAX_METRICS];
+				CachedCall CallCache[64]; //Indexed by the addresses of the names
+				std::unordered_map<std::string, int> CallSlots; //Full name of a call -> its pair of counters
+			};
+
+			// Registers the counters of the calling thread, pCounters is redirected to a discarded set when the thread exits
+			void CreateThreadCounters(ThreadCounters*& pCounters);
+
+			inline ThreadCounters& Local(void)
+			{
+				//A plain pointer stays valid while thread_local objects (and statics) are destroyed, objects may still be collected then
+				thread_local ThreadCounters* s_pCounters = nullptr;
+				if(!s_pCounters)
+					CreateThreadCounters(s_pCounters);
+				return *s_pCounters;
+			}
+
+			// A relaxed load and store, no read-modify-write, readers on other threads only need eventual values
+			inline void Increment(int counter)
+			{
+				auto& value = Local().Values[counter];
+				value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+
+			inline void CountBindingCall(void) { Increment(BindingCalls); }
+
+			// First counter of the (calls, errors) pair of a call, tableName is nullptr for global functions
+			int CallCounter(const char* tableName, const char* functionName);
+
+			// First counter of the (wrapped, released) pair of a class
+			int ClassCounter(const char* className);
+
+			// Starts the counters of a new state at the current totals
+			void MarkStateCreated(void);
+
+			// Fills in the counters of a snapshot, since the process started or since the current state was created
+			void Collect(LuaMetricsSnapshot& snapshot, bool sinceStateCreated);
+
+			// Highest values of all states that were closed, the current state's are kept by LuaScript
+			struct Peaks
+			{
+				size_t HeapBytes;
+				int CallDepth;
+				int StackSize;
+			};
+			Peaks& ClosedStatePeaks(void);
+		}
+	}
+}
+
+#include "LuaMetrics.inl"
@@ -0,0 +1,354 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifdef LUALINK_DEFINE
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+namespace LuaLink
+{
+	namespace detail {
+		namespace Metrics {
+			struct Registry
+			{
+				Registry(void) : Retired(LUALINK_MAX_METRICS), StateBaseline(LUALINK_MAX_METRICS), NextCounter(NrOfCounters) {}
+
+				std::mutex Mutex;
+				std::vector<ThreadCounters*> Threads;
+				std::vector<unsigned long long> Retired; //Totals of threads that exited
+				std::vector<unsigned long long> StateBaseline; //Totals when the current state was created
+				std::map<std::string, int> Calls; //Name -> first counter of its pair
+				std::map<std::string, int> Classes;
+				int NextCounter;
+			};
+
+			//Never destroyed, lua_close may still count objects released during static destruction
+			Registry& GetRegistry(void)
+			{
+				static Registry* s_pRegistry = new Registry();
+				return *s_pRegistry;
+			}
+
+			ThreadCounters::ThreadCounters(void)
+			{
+				for(auto& value : Values)
+					value.store(0, std::memory_order_relaxed);
+				for(auto& cached : CallCache){
+					cached.pTableName = nullptr;
+					cached.pFunctionName = nullptr;
+					cached.Counter = -1;
+				}
+			}
+
+			//Folds the counters of a thread into the totals when it exits
+			struct RetiredCounters
+			{
+				ThreadCounters** ppCounters;
+
+				~RetiredCounters(void)
+				{
+					static ThreadCounters* s_pDiscarded = new ThreadCounters();
+
+					ThreadCounters* pCounters = *ppCounters;
+					*ppCounters = s_pDiscarded;
+
+					auto& registry = GetRegistry();
+					std::lock_guard<std::mutex> lock(registry.Mutex);
+					for(int i = 0; i < LUALINK_MAX_METRICS; ++i)
+						registry.Retired[i] += pCounters->Values[i].load(std::memory_order_relaxed);
+					registry.Threads.erase(std::find(registry.Threads.begin(), registry.Threads.end(), pCounters));
+					delete pCounters;
+				}
+			};
+
+			void CreateThreadCounters(ThreadCounters*& pCounters)
+			{
+				pCounters = new ThreadCounters();
+				{
+					auto& registry = GetRegistry();
+					std::lock_guard<std::mutex> lock(registry.Mutex);
+					registry.Threads.push_back(pCounters);
+				}
+
+				thread_local RetiredCounters s_Retired = { &pCounters };
+				(void)s_Retired;
+			}
+
+			//Caller holds the lock
+			static int AddCounterPair(std::map<std::string, int>& names, const std::string& name, int sharedCounter)
+			{
+				auto it = names.find(name);
+				if(it != names.end())
+					return it->second;
+
+				auto& registry = GetRegistry();
+				if(registry.NextCounter + 2 > LUALINK_MAX_METRICS)
+					return sharedCounter;
+
+				int counter = registry.NextCounter;
+				registry.NextCounter += 2;
+				names.insert(std::make_pair(name, counter));
+				return counter;
+			}
+
+			static bool IsSameName(const char* pName, const std::string& cached)
+			{
+				return pName ? cached.compare(pName) == 0 : cached.empty();
+			}
+
+			int CallCounter(const char* tableName, const char* functionName)
+			{
+				auto& local = Local();
+
+				//Call sites pass the same pointers every time, only the (short) names are compared on a hit
+				size_t slot = ((reinterpret_cast<size_t>(functionName) >> 3) ^ (reinterpret_cast<size_t>(tableName) >> 5)) % 64;
+				auto& cached = local.CallCache[slot];
+				if(cached.Counter >= 0 && cached.pFunctionName == functionName && cached.pTableName == tableName
+					&& IsSameName(functionName, cached.FunctionName) && IsSameName(tableName, cached.TableName))
+					return cached.Counter;
+
+				//Names don't have to be literals, so they are looked up by value rather than by address
+				std::string name = tableName ? std::string(tableName) + "." + functionName : std::string(functionName);
+				int counter = 0;
+				auto it = local.CallSlots.find(name);
+				if(it != local.CallSlots.end())
+					counter = it->second;
+				else{
+					{
+						auto& registry = GetRegistry();
+						std::lock_guard<std::mutex> lock(registry.Mutex);
+						counter = AddCounterPair(registry.Calls, name, OtherCalls);
+					}
+					local.CallSlots.insert(std::make_pair(std::move(name), counter));
+				}
+
+				cached.pTableName = tableName;
+				cached.pFunctionName = functionName;
+				cached.TableName = tableName ? tableName : "";
+				cached.FunctionName = functionName;
+				cached.Counter = counter;
+				return counter;
+			}
+
+			int ClassCounter(const char* className)
+			{
+				auto& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.Mutex);
+				return AddCounterPair(registry.Classes, className, OtherObjectsWrapped);
+			}
+
+			//Caller holds the lock
+			static std::vector<unsigned long long> Totals(Registry& registry)
+			{
+				std::vector<unsigned long long> totals(registry.Retired);
+				for(auto pThread : registry.Threads)
+					for(int i = 0; i < LUALINK_MAX_METRICS; ++i)
+						totals[i] += pThread->Values[i].load(std::memory_order_relaxed);
+				return totals;
+			}
+
+			void MarkStateCreated(void)
+			{
+				auto& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.Mutex);
+				registry.StateBaseline = Totals(registry);
+			}
+
+			void Collect(LuaMetricsSnapshot& snapshot, bool sinceStateCreated)
+			{
+				auto& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.Mutex);
+
+				auto totals = Totals(registry);
+				std::vector<unsigned long long> baseline(LUALINK_MAX_METRICS);
+				if(sinceStateCreated)
+					baseline = registry.StateBaseline;
+
+				auto count = [&](int counter) { return totals[counter] - baseline[counter]; };
+
+				snapshot.BindingCalls = count(BindingCalls);
+				snapshot.Exceptions = count(Exceptions);
+				snapshot.GCCycles = count(GCCycles);
+
+				//Functions that weren't called in the period are left out
+				auto addCall = [&](const std::string& name, int counter) {
+					LuaCallMetrics metrics = { count(counter), count(counter + 1) };
+					if(metrics.Calls != 0 || metrics.Errors != 0)
+						snapshot.Calls[name] = metrics;
+				};
+				for(auto& call : registry.Calls)
+					addCall(call.first, call.second);
+				addCall("(other)", OtherCalls);
+
+				//Live objects are a level rather than a count, objects of previous states were all released when they were closed
+				for(auto& cls : registry.Classes)
+					snapshot.LiveObjects[cls.first] = static_cast<long long>(totals[cls.second] - totals[cls.second + 1]);
+				if(totals[OtherObjectsWrapped] != 0)
+					snapshot.LiveObjects["(other)"] = static_cast<long long>(totals[OtherObjectsWrapped] - totals[OtherObjectsReleased]);
+			}
+
+			Peaks& ClosedStatePeaks(void)
+			{
+				static Peaks s_Peaks = {};
+				return s_Peaks;
+			}
+
+			static std::string EscapeLabel(const std::string& value)
+			{
+				std::string escaped;
+				for(char c : value){
+					if(c == '\\' || c == '"')
+						escaped += '\\';
+					if(c == '\n'){
+						escaped += "\\n";
+						continue;
+					}
+					escaped += c;
+				}
+				return escaped;
+			}
+
+			static std::string EscapeJson(const std::string& value)
+			{
+				std::string escaped;
+				for(char c : value){
+					if(c == '\\' || c == '"')
+						escaped += '\\';
+					if(static_cast<unsigned char>(c) < 0x20){
+						char code[8];
+						snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+						escaped += code;
+						continue;
+					}
+					escaped += c;
+				}
+				return escaped;
+			}
+
+			static void FormatPrometheus(std::ostream& out, const LuaMetricsSnapshot& snapshot)
+			{
+				auto metric = [&out](const char* name, const char* type, const char* help) {
+					out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+				};
+
+				metric("lualink_calls_total", "counter", "Calls into Lua through CallFunction/CallMethod.");
+				for(auto& call : snapshot.Calls)
+					out << "lualink_calls_total{function=\"" << EscapeLabel(call.first) << "\"} " << call.second.Calls << '\n';
+
+				metric("lualink_call_errors_total", "counter", "Calls into Lua that failed.");
+				for(auto& call : snapshot.Calls)
+					out << "lualink_call_errors_total{function=\"" << EscapeLabel(call.first) << "\"} " << call.second.Errors << '\n';
+
+				metric("lualink_binding_calls_total", "counter", "Calls from Lua to bound C++ functions, methods and constructors.");
+				out << "lualink_binding_calls_total " << snapshot.BindingCalls << '\n';
+
+				metric("lualink_exceptions_total", "counter", "Exceptions thrown by LuaLink.");
+				out << "lualink_exceptions_total " << snapshot.Exceptions << '\n';
+
+				metric("lualink_live_objects", "gauge", "Objects wrapped for Lua.");
+				for(auto& cls : snapshot.LiveObjects)
+					out << "lualink_live_objects{class=\"" << EscapeLabel(cls.first) << "\"} " << cls.second << '\n';
+
+				metric("lualink_gc_cycles_total", "counter", "Completed garbage collection cycles.");
+				out << "lualink_gc_cycles_total " << snapshot.GCCycles << '\n';
+
+				metric("lualink_heap_bytes", "gauge", "Size of the Lua heap.");
+				out << "lualink_heap_bytes " << snapshot.HeapBytes << '\n';
+
+				metric("lualink_heap_peak_bytes", "gauge", "Largest size of the Lua heap.");
+				out << "lualink_heap_peak_bytes " << snapshot.PeakHeapBytes << '\n';
+
+				metric("lualink_call_depth_peak", "gauge", "Deepest nesting of calls into Lua.");
+				out << "lualink_call_depth_peak " << snapshot.PeakCallDepth << '\n';
+
+				metric("lualink_stack_size_peak", "gauge", "Largest Lua stack when a call into Lua started.");
+				out << "lualink_stack_size_peak " << snapshot.PeakStackSize << '\n';
+			}
+
+			static void FormatJson(std::ostream& out, const LuaMetricsSnapshot& snapshot)
+			{
+				out << "{\"calls\":{";
+				bool isFirst = true;
+				for(auto& call : snapshot.Calls){
+					out << (isFirst ? "" : ",") << '"' << EscapeJson(call.first) << "\":{\"calls\":" << call.second.Calls << ",\"errors\":" << call.second.Errors << '}';
+					isFirst = false;
+				}
+
+				out << "},\"live_objects\":{";
+				isFirst = true;
+				for(auto& cls : snapshot.LiveObjects){
+					out << (isFirst ? "" : ",") << '"' << EscapeJson(cls.first) << "\":" << cls.second;
+					isFirst = false;
+				}
+
+				out << "},\"binding_calls\":" << snapshot.BindingCalls
+					<< ",\"exceptions\":" << snapshot.Exceptions
+					<< ",\"gc_cycles\":" << snapshot.GCCycles
+					<< ",\"heap_bytes\":" << snapshot.HeapBytes
+					<< ",\"peak_heap_bytes\":" << snapshot.PeakHeapBytes
+					<< ",\"peak_call_depth\":" << snapshot.PeakCallDepth
+					<< ",\"peak_stack_size\":" << snapshot.PeakStackSize << "}\n";
+			}
+		}
+	}
+
+	std::string LuaMetrics::Format(const LuaMetricsSnapshot& snapshot, LuaMetricsFormat format)
+	{
+		std::ostringstream out;
+		if(format == LuaMetricsFormat::Json)
+			detail::Metrics::FormatJson(out, snapshot);
+		else
+			detail::Metrics::FormatPrometheus(out, snapshot);
+		return out.str();
+	}
+
+	bool LuaMetrics::WriteFile(const char* filename, const LuaMetricsSnapshot& snapshot, LuaMetricsFormat format)
+	{
+		//Scrapers never see a half-written file
+		std::string tempFilename = std::string(filename) + ".tmp";
+		{
+			std::ofstream file(tempFilename.c_str(), std::ios::binary | std::ios::trunc);
+			if(!file)
+				return false;
+
+			file << Format(snapshot, format);
+			if(!file.good())
+				return false;
+		}
+
+		//rename doesn't replace existing files everywhere
+		if(std::rename(tempFilename.c_str(), filename) != 0){
+			std::remove(filename);
+			if(std::rename(tempFilename.c_str(), filename) != 0){
+				std::remove(tempFilename.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void LuaMetrics::Export(const LuaMetricsSnapshot& snapshot, LuaMetricsFormat format, void(*pfnExport)(const std::string& text, void* pUserData), void* pUserData)
+	{
+		pfnExport(Format(snapshot, format), pUserData);
+	}
+}
+
+#endif
@@ -0,0 +1,105 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "LuaCompat.h"
+
+namespace LuaLink
+{
+	// // Script loaded once by LuaScript::LoadChunk/LoadChunkString, to be run in any number of sandboxes
+	// // Only valid for the lua_State it was loaded in
+	class LuaChunk final
+	{
+	public:
+		LuaChunk(void);
+		~LuaChunk(void);
+		LuaChunk(LuaChunk&& src);
+		LuaChunk& operator=(LuaChunk&& src);
+
+		bool IsLoaded(void) const;
+
+	private:
+		friend class LuaScript;
+		friend class LuaSandbox;
+
+		lua_State* m_pLuaState;
+		int m_Ref; //Registry reference to the loaded function
+
+		LuaChunk(const LuaChunk& src) = delete;
+		LuaChunk& operator=(const LuaChunk& src) = delete;
+	};
+
+	// // Isolated global environment (_ENV) in the state of LuaScript, e.g. one per request
+	// // Committed bindings and library globals are visible through a shared metatable, globals assigned inside stay inside
+	// // Shared tables (libraries, classes, constants) are seen through read-only proxies
+	// // The environment is created on first use, dropping it (Reset or destruction) releases everything the scripts defined
+	class LuaSandbox final
+	{
+	public:
+		LuaSandbox(void);
+		~LuaSandbox(void);
+		LuaSandbox(LuaSandbox&& src);
+		LuaSandbox& operator=(LuaSandbox&& src);
+
+		// // Runs the chunk with this sandbox as its global environment, throws a LuaCallException if it raises an error
+		void Run(const LuaChunk& chunk);
+
+		template<typename _RetType, typename... _ArgTypes>
+		// // Calls a function defined in this sandbox (or a shared global function)
+		_RetType CallFunction(const char* fnName, _ArgTypes... args);
+
+		// // Drops every global defined in this sandbox, the next use starts from the shared globals again
+		void Reset(void);
+
+	private:
+		template<typename _RetType>
+		struct Call;
+
+		// // Pushes the environment table, creating it if this sandbox doesn't have one (yet)
+		void PushEnvironment(lua_State* L);
+
+		// // Pushes the metatable shared by all environments, which falls back to the globals of the state
+		static void PushSharedMetatable(lua_State* L);
+
+		// // Replaces the table on top of the stack with a read-only proxy for it, from the proxy cache at cacheIdx
+		static void PushReadOnly(lua_State* L, int cacheIdx);
+
+		// // Pushes the sandbox's version of the global named at index 2 (nil if it is left out), returns false for other globals
+		// // Loaders compile against the global table, the environment at index 1 is given to them instead
+		static bool PushSandboxedGlobal(lua_State* L);
+
+		//Lua callbacks
+		static int SharedIndex(lua_State* L);
+		static int SandboxLoad(lua_State* L);
+		static int SandboxDoFile(lua_State* L);
+		static int ProxyIndex(lua_State* L);
+		static int ProxyNewIndex(lua_State* L);
+		static int ProxyLen(lua_State* L);
+		static int ProxyPairs(lua_State* L);
+		static int ProxyNext(lua_State* L);
+		static int ProxyCall(lua_State* L);
+
+		lua_State* m_pLuaState;
+		int m_EnvRef; //Registry reference to the environment table, LUA_NOREF until first use
+
+		LuaSandbox(const LuaSandbox& src) = delete;
+		LuaSandbox& operator=(const LuaSandbox& src) = delete;
+	};
+}
+
+#include "LuaSandbox.inl"
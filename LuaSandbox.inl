@@ -0,0 +1,492 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "LuaScript.hpp"
+#include "LuaStack.hpp"
+
+#include <cstring>
+#include <sstream>
+
+namespace LuaLink
+{
+	//Call implementations, same as LuaScript's but the function is looked up in the sandbox
+	template<typename _RetType>
+	struct LuaSandbox::Call
+	{
+		template<typename... _ArgTypes>
+		static _RetType LuaFunction(LuaSandbox& sandbox, const char* functionName, _ArgTypes... arguments)
+		{
+			lua_State* L = LuaScript::GetLuaState();
+			int top = lua_gettop(L);
+
+			sandbox.PushEnvironment(L);
+			lua_getfield(L, -1, functionName);
+			if(!lua_isfunction(L, -1)){
+				lua_settop(L, top);
+				throw LuaCallException(("Function not found in sandbox: " + std::string(functionName)).c_str());
+			}
+
+			int fnIdx = lua_gettop(L);
+
+			LuaStack::pushStack<_ArgTypes...>(L, arguments...);
+
+			if(LuaScript::ProtectedCall(lua_gettop(L) - fnIdx, detail::ResultCount<_RetType>::value) != 0)
+				LuaScript::ThrowCallError(top);
+
+			bool isOk = true;
+			auto ret = detail::Results<_RetType>::get(L, isOk);
+			lua_settop(L, top);
+			if(!isOk){
+				std::stringstream strstr;
+				strstr << "Error: Expected return type " << typeid(_RetType).name() << " does not match the value returned by " << functionName;
+				throw LuaCallException(strstr.str().c_str());
+			}
+
+			return ret;
+		}
+	};
+
+	template<>
+	struct LuaSandbox::Call<void>
+	{
+		template<typename... _ArgTypes>
+		static void LuaFunction(LuaSandbox& sandbox, const char* functionName, _ArgTypes... arguments)
+		{
+			lua_State* L = LuaScript::GetLuaState();
+			int top = lua_gettop(L);
+
+			sandbox.PushEnvironment(L);
+			lua_getfield(L, -1, functionName);
+			if(!lua_isfunction(L, -1)){
+				lua_settop(L, top);
+				throw LuaCallException(("Function not found in sandbox: " + std::string(functionName)).c_str());
+			}
+
+			int fnIdx = lua_gettop(L);
+
+			LuaStack::pushStack<_ArgTypes...>(L, arguments...);
+
+			if(LuaScript::ProtectedCall(lua_gettop(L) - fnIdx, 0) != 0)
+				LuaScript::ThrowCallError(top);
+
+			lua_settop(L, top);
+		}
+	};
+
+	template<typename _RetType, typename... _ArgTypes>
+	_RetType LuaSandbox::CallFunction(const char* fnName, _ArgTypes... args)
+	{
+		return LuaSandbox::Call<_RetType>::LuaFunction(*this, fnName, args...);
+	}
+}
+
+#ifdef LUALINK_DEFINE
+
+namespace LuaLink
+{
+	namespace detail {
+		namespace LuaSandbox {
+			//Registry key of the metatable shared by all sandbox environments
+			static char s_SharedMetatableKey;
+		}
+	}
+
+	//LuaChunk
+
+	LuaChunk::LuaChunk(void) : m_pLuaState(nullptr), m_Ref(LUA_NOREF) {}
+
+	LuaChunk::~LuaChunk(void)
+	{
+		//References into a state that was closed or replaced are gone already
+		if(m_pLuaState && m_pLuaState == LuaScript::GetLuaState())
+			luaL_unref(m_pLuaState, LUA_REGISTRYINDEX, m_Ref);
+	}
+
+	LuaChunk::LuaChunk(LuaChunk&& src) : m_pLuaState(src.m_pLuaState), m_Ref(src.m_Ref)
+	{
+		src.m_pLuaState = nullptr;
+		src.m_Ref = LUA_NOREF;
+	}
+
+	LuaChunk& LuaChunk::operator=(LuaChunk&& src)
+	{
+		if(this != &src){
+			this->~LuaChunk();
+			m_pLuaState = src.m_pLuaState;
+			m_Ref = src.m_Ref;
+			src.m_pLuaState = nullptr;
+			src.m_Ref = LUA_NOREF;
+		}
+		return *this;
+	}
+
+	bool LuaChunk::IsLoaded(void) const
+	{
+		return m_pLuaState && m_pLuaState == LuaScript::GetLuaState() && m_Ref != LUA_NOREF;
+	}
+
+	//LuaSandbox
+
+	LuaSandbox::LuaSandbox(void) : m_pLuaState(nullptr), m_EnvRef(LUA_NOREF) {}
+
+	LuaSandbox::~LuaSandbox(void)
+	{
+		Reset();
+	}
+
+	LuaSandbox::LuaSandbox(LuaSandbox&& src) : m_pLuaState(src.m_pLuaState), m_EnvRef(src.m_EnvRef)
+	{
+		src.m_pLuaState = nullptr;
+		src.m_EnvRef = LUA_NOREF;
+	}
+
+	LuaSandbox& LuaSandbox::operator=(LuaSandbox&& src)
+	{
+		if(this != &src){
+			Reset();
+			m_pLuaState = src.m_pLuaState;
+			m_EnvRef = src.m_EnvRef;
+			src.m_pLuaState = nullptr;
+			src.m_EnvRef = LUA_NOREF;
+		}
+		return *this;
+	}
+
+	void LuaSandbox::Run(const LuaChunk& chunk)
+	{
+		if(!chunk.IsLoaded())
+			throw LuaCallException("Chunk isn't loaded in the current state");
+
+		lua_State* L = LuaScript::GetLuaState();
+		int top = lua_gettop(L);
+
+		lua_rawgeti(L, LUA_REGISTRYINDEX, chunk.m_Ref);
+		PushEnvironment(L);
+
+#if LUA_VERSION_NUM >= 502
+		//The chunk was loaded as "local _ENV = ...", every run gets its own _ENV upvalue
+		int nrOfArgs = 1;
+#else
+		//Functions created by the chunk keep the environment they were created in
+		lua_setfenv(L, -2);
+		int nrOfArgs = 0;
+#endif
+
+		if(LuaScript::ProtectedCall(nrOfArgs, 0) != 0)
+			LuaScript::ThrowCallError(top);
+
+		lua_settop(L, top);
+	}
+
+	void LuaSandbox::Reset(void)
+	{
+		if(m_pLuaState && m_pLuaState == LuaScript::GetLuaState())
+			luaL_unref(m_pLuaState, LUA_REGISTRYINDEX, m_EnvRef);
+
+		m_pLuaState = nullptr;
+		m_EnvRef = LUA_NOREF;
+	}
+
+	void LuaSandbox::PushEnvironment(lua_State* L)
+	{
+		if(m_pLuaState == L && m_EnvRef != LUA_NOREF){
+			lua_rawgeti(L, LUA_REGISTRYINDEX, m_EnvRef);
+			return;
+		}
+
+		lua_newtable(L);
+		PushSharedMetatable(L);
+		lua_setmetatable(L, -2);
+
+		//_G refers to the sandbox, so scripts can't reach around it into the shared globals
+		lua_pushvalue(L, -1);
+		lua_setfield(L, -2, "_G");
+
+		lua_pushvalue(L, -1);
+		m_EnvRef = luaL_ref(L, LUA_REGISTRYINDEX);
+		m_pLuaState = L;
+	}
+
+	void LuaSandbox::PushSharedMetatable(lua_State* L)
+	{
+		lua_rawgetp(L, LUA_REGISTRYINDEX, &detail::LuaSandbox::s_SharedMetatableKey);
+		if(lua_istable(L, -1))
+			return;
+		lua_pop(L, 1);
+
+		lua_createtable(L, 0, 2);
+		lua_newtable(L); //Proxy cache of each environment
+		lua_createtable(L, 0, 1);
+		lua_pushstring(L, "k");
+		lua_setfield(L, -2, "__mode");
+		lua_setmetatable(L, -2);
+		lua_pushcclosure(L, SharedIndex, 1);
+		lua_setfield(L, -2, "__index");
+
+		//Hide the metatable from getmetatable, it leads to the shared globals
+		lua_pushboolean(L, 0);
+		lua_setfield(L, -2, "__metatable");
+
+		lua_pushvalue(L, -1);
+		lua_rawsetp(L, LUA_REGISTRYINDEX, &detail::LuaSandbox::s_SharedMetatableKey);
+	}
+
+	void LuaSandbox::PushReadOnly(lua_State* L, int cacheIdx)
+	{
+		lua_pushvalue(L, -1);
+		lua_rawget(L, cacheIdx);
+		if(!lua_isnil(L, -1)){
+			lua_remove(L, -2);
+			return;
+		}
+		lua_pop(L, 1);
+		int original = lua_gettop(L);
+
+		lua_newtable(L);
+		lua_createtable(L, 0, 6);
+
+		lua_pushvalue(L, cacheIdx);
+		lua_pushvalue(L, original);
+		lua_pushcclosure(L, ProxyIndex, 2);
+		lua_setfield(L, -2, "__index");
+
+		lua_pushcfunction(L, ProxyNewIndex);
+		lua_setfield(L, -2, "__newindex");
+
+		lua_pushvalue(L, original);
+		lua_pushcclosure(L, ProxyLen, 1);
+		lua_setfield(L, -2, "__len");
+
+		lua_pushvalue(L, cacheIdx);
+		lua_pushvalue(L, original);
+		lua_pushcclosure(L, ProxyNext, 2);
+		lua_pushcclosure(L, ProxyPairs, 1);
+		lua_setfield(L, -2, "__pairs");
+
+		//Class and constant tables can be called
+		if(lua_getmetatable(L, original)){
+			lua_pushstring(L, "__call");
+			lua_rawget(L, -2);
+			bool isCallable = !lua_isnil(L, -1);
+			lua_pop(L, 2);
+
+			if(isCallable){
+				lua_pushvalue(L, original);
+				lua_pushcclosure(L, ProxyCall, 1);
+				lua_setfield(L, -2, "__call");
+			}
+		}
+
+		//Hide the metatable, it leads to the original table
+		lua_pushboolean(L, 0);
+		lua_setfield(L, -2, "__metatable");
+		lua_setmetatable(L, -2);
+
+		lua_pushvalue(L, original);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, cacheIdx);
+
+		lua_replace(L, original);
+	}
+
+	//__index of every environment: looks the key up in the globals of the state, tables are returned as read-only proxies
+	int LuaSandbox::SharedIndex(lua_State* L)
+	{
+		lua_settop(L, 2);
+		if(PushSandboxedGlobal(L))
+			return 1;
+
+		lua_pushglobaltable(L);
+		lua_pushvalue(L, 2);
+		lua_gettable(L, 3);
+		if(!lua_istable(L, -1))
+			return 1;
+
+		//Proxies are cached per environment, so one modified with rawset only affects the sandbox that did it
+		lua_pushvalue(L, 1);
+		lua_rawget(L, lua_upvalueindex(1));
+		if(lua_isnil(L, -1)){
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_createtable(L, 0, 1);
+			lua_pushstring(L, "k");
+			lua_setfield(L, -2, "__mode");
+			lua_setmetatable(L, -2);
+
+			lua_pushvalue(L, 1);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, lua_upvalueindex(1));
+		}
+		lua_insert(L, -2);
+
+		PushReadOnly(L, lua_gettop(L) - 1);
+		return 1;
+	}
+
+	bool LuaSandbox::PushSandboxedGlobal(lua_State* L)
+	{
+		if(lua_type(L, 2) != LUA_TSTRING)
+			return false;
+
+		//Position of the environment argument of each loader
+		static const struct { const char* Name; int EnvArg; } s_Loaders[] = { { "load", 4 }, { "loadstring", 4 }, { "loadfile", 3 }, { "dofile", 0 } };
+		//Modules are cached for the whole state, and fenv functions reach the global table
+		static const char* s_LeftOut[] = { "require", "getfenv", "setfenv" };
+
+		const char* name = lua_tostring(L, 2);
+		for(auto leftOut : s_LeftOut){
+			if(strcmp(name, leftOut) == 0){
+				lua_pushnil(L);
+				return true;
+			}
+		}
+
+		for(auto& loader : s_Loaders)
+		{
+			if(strcmp(name, loader.Name) != 0)
+				continue;
+
+			lua_getglobal(L, loader.Name);
+			if(!lua_isfunction(L, -1))
+				return true;
+
+			if(loader.EnvArg == 0){
+				//dofile goes through the sandbox's loadfile
+				lua_pop(L, 1);
+				lua_getglobal(L, "loadfile");
+				if(!lua_isfunction(L, -1))
+					return true;
+			}
+
+			lua_pushvalue(L, 1);
+			lua_pushinteger(L, loader.EnvArg == 0 ? 3 : loader.EnvArg);
+			lua_pushcclosure(L, SandboxLoad, 3);
+			if(loader.EnvArg == 0)
+				lua_pushcclosure(L, SandboxDoFile, 1);
+
+			//Created once per sandbox
+			lua_pushvalue(L, 2);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, 1);
+			return true;
+		}
+		return false;
+	}
+
+	//Upvalues: original loader, environment, position of the loader's environment argument
+	int LuaSandbox::SandboxLoad(lua_State* L)
+	{
+#if LUA_VERSION_NUM >= 502
+		//An explicit environment is kept
+		int envArg = static_cast<int>(lua_tointeger(L, lua_upvalueindex(3)));
+		if(lua_gettop(L) < envArg){
+			lua_settop(L, envArg - 1);
+			lua_pushvalue(L, lua_upvalueindex(2));
+		}
+#endif
+
+		lua_pushvalue(L, lua_upvalueindex(1));
+		lua_insert(L, 1);
+		lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+
+#if LUA_VERSION_NUM < 502
+		if(lua_isfunction(L, 1)){
+			lua_pushvalue(L, lua_upvalueindex(2));
+			lua_setfenv(L, 1);
+		}
+#endif
+		return lua_gettop(L);
+	}
+
+	//Upvalue: the sandbox's loadfile
+	int LuaSandbox::SandboxDoFile(lua_State* L)
+	{
+		lua_settop(L, 1);
+		lua_pushvalue(L, lua_upvalueindex(1));
+		lua_pushvalue(L, 1);
+		lua_call(L, 1, 2);
+		if(lua_isnil(L, -2))
+			return lua_error(L);
+
+		lua_pop(L, 1);
+		lua_call(L, 0, LUA_MULTRET);
+		return lua_gettop(L) - 1;
+	}
+
+	//Upvalues: proxy cache, original table
+	int LuaSandbox::ProxyIndex(lua_State* L)
+	{
+		lua_settop(L, 2);
+		lua_pushvalue(L, 2);
+		lua_gettable(L, lua_upvalueindex(2));
+		if(lua_istable(L, -1))
+			PushReadOnly(L, lua_upvalueindex(1));
+		return 1;
+	}
+
+	int LuaSandbox::ProxyNewIndex(lua_State* L)
+	{
+		return luaL_error(L, "attempt to modify a shared table from a sandbox");
+	}
+
+	//Upvalue: original table
+	int LuaSandbox::ProxyLen(lua_State* L)
+	{
+		lua_pushinteger(L, static_cast<lua_Integer>(lua_rawlen(L, lua_upvalueindex(1))));
+		return 1;
+	}
+
+	//Upvalue: ProxyNext, iterates the proxy so the original table doesn't end up in the script
+	int LuaSandbox::ProxyPairs(lua_State* L)
+	{
+		lua_pushvalue(L, lua_upvalueindex(1));
+		lua_pushvalue(L, 1);
+		lua_pushnil(L);
+		return 3;
+	}
+
+	//Upvalues: proxy cache, original table
+	int LuaSandbox::ProxyNext(lua_State* L)
+	{
+		lua_settop(L, 2);
+		lua_pushvalue(L, lua_upvalueindex(2));
+		lua_pushvalue(L, 2);
+		if(!lua_next(L, 3)){
+			lua_pushnil(L);
+			return 1;
+		}
+
+		if(lua_istable(L, -1))
+			PushReadOnly(L, lua_upvalueindex(1));
+		return 2;
+	}
+
+	//Upvalue: original table, called with the original instead of the proxy
+	int LuaSandbox::ProxyCall(lua_State* L)
+	{
+		int nrOfArgs = lua_gettop(L) - 1;
+		lua_pushvalue(L, lua_upvalueindex(1));
+		lua_replace(L, 1);
+		lua_pushvalue(L, 1);
+		lua_insert(L, 1);
+
+		lua_call(L, nrOfArgs + 1, LUA_MULTRET);
+		return lua_gettop(L);
+	}
+}
+
+#endif
@@ -17,25 +17,152 @@
 
 #pragma once
 
-#include <lua.hpp>
+#include "LuaCompat.h"
+#include "LuaMetrics.hpp"
+#include "LuaTrace.hpp"
 #include <string>
 
 #include <map>
 
 #include <memory>
 
+#include <chrono>
+
+#include <typeinfo>
+
+#include <deque>
+
 template<>
 //Specify policy to release lua_State*
 struct std::default_delete<lua_State>{
 	void operator()(lua_State* ptr){
-		if(ptr)
+		if(ptr){
+			//Finalizers that run during lua_close check this, the unique_ptr may still return ptr and statics may be gone already
+			lua_pushboolean(ptr, 1);
+			lua_setfield(ptr, LUA_REGISTRYINDEX, "LuaLink.Closing");
 			lua_close(ptr);
+		}
 	}
 };
 
 namespace LuaLink
 {
 	template<typename T>class LuaClass;
+	class LuaChunk;
+	class LuaBundle;
+	namespace detail { class CallbackRef; }
+
+	// // Limits on how much a single call into Lua may execute before it is aborted with a LuaTimeoutException (0 means unlimited)
+	struct LuaBudget
+	{
+		LuaBudget(unsigned long long maxInstructions = 0, double maxMilliseconds = 0.0) : MaxInstructions(maxInstructions), MaxMilliseconds(maxMilliseconds) {}
+		
+		bool IsLimited(void) const { return MaxInstructions != 0 || MaxMilliseconds > 0.0; }
+		
+		unsigned long long MaxInstructions; //VM instructions, counted with the granularity of the check interval
+		double MaxMilliseconds; //Wall-clock time, measured with a monotonic clock
+	};
+	
+	// // How close budgeted calls come to their limits, use this to tune the budgets
+	struct LuaBudgetStats
+	{
+		unsigned long long Calls; //Calls that ran under a budget
+		unsigned long long Timeouts; //Calls that were aborted
+		double PeakInstructionUsage; //Highest fraction of its instruction budget used by a call that completed
+		double PeakTimeUsage; //Highest fraction of its time budget used by a call that completed
+		unsigned long long UsageHistogram[5]; //Completed calls by fraction of their tightest limit used: <25%, <50%, <75%, <90%, >=90%
+	};
+
+	// // Garbage collector modes, generational collection needs Lua 5.2 or 5.4
+	enum class LuaGCMode
+	{
+		Incremental,
+		Generational
+	};
+	
+	// // Garbage collector activity, collections are counted whether they were triggered by Lua or by the host
+	struct LuaGCStats
+	{
+		unsigned long long Collections; //Completed cycles
+		unsigned long long Steps; //Explicit steps and full collections requested through LuaScript
+		double StepMilliseconds; //Time spent in those, automatic steps inside calls aren't included
+		double PeakStepMilliseconds;
+		size_t BytesFreedLastCycle;
+		size_t PeakHeapBytes; //Only tracked while the state uses LuaLink's allocator
+		size_t ExternalBytes; //Memory credited for live objects of classes with an external size
+	};
+	
+	// // Heap size at the end of a collection cycle
+	struct LuaGCCycle
+	{
+		double Milliseconds; //Since the state was created
+		size_t HeapBytes;
+		size_t BytesFreed; //Since the end of the previous cycle
+	};
+
+	// // Why a call made through LuaScript::TryCallFunction/TryCallMethod failed
+	enum class LuaCallError
+	{
+		None,
+		NotFound,			//The global function, table or method doesn't exist
+		NotAFunction,		//The name refers to something that can't be called
+		NotATable,			//The table name refers to something that isn't a table
+		Runtime,			//The script raised an error
+		Timeout,			//The call went over its LuaBudget
+		OutOfMemory,
+		ReturnTypeMismatch	//The call succeeded, but returned something that can't be converted to the requested type
+	};
+
+	// // Outcome of a call that doesn't throw, the message is only formatted when asked for
+	// // Keeps the names passed to the call, they have to outlive the result to format its message
+	class LuaCallResult
+	{
+	public:
+		LuaCallError GetError(void) const { return m_Error; }
+		bool IsOk(void) const { return m_Error == LuaCallError::None; }
+		explicit operator bool(void) const { return IsOk(); }
+		
+		// // Same messages as the exceptions thrown by CallFunction/CallMethod, empty on success
+		std::string GetMessage(void) const;
+
+	protected:
+		friend class LuaScript;
+		
+		LuaCallResult(const char* tableName, const char* functionName, const std::type_info* pReturnType) :
+			m_Error(LuaCallError::None), m_TableName(tableName), m_FunctionName(functionName), m_pReturnType(pReturnType), m_IsTableFound(false) {}
+		
+		LuaCallError m_Error;
+		const char* m_TableName; //nullptr for global functions
+		const char* m_FunctionName;
+		const std::type_info* m_pReturnType;
+		std::string m_ScriptMessage; //Error raised by the script, only filled in when the call failed
+		bool m_IsTableFound; //NotFound refers to the function in the table rather than to the table
+	};
+
+	template<typename T>
+	class LuaResult : public LuaCallResult
+	{
+	public:
+		// // Throws a LuaCallException when the call failed
+		const T& Value(void) const;
+		T ValueOr(T fallback) const { return IsOk() ? m_Value : fallback; }
+
+	private:
+		friend class LuaScript;
+		
+		LuaResult(const char* tableName, const char* functionName) : LuaCallResult(tableName, functionName, &typeid(T)), m_Value() {}
+		
+		T m_Value;
+	};
+
+	template<>
+	class LuaResult<void> : public LuaCallResult
+	{
+	private:
+		friend class LuaScript;
+		
+		LuaResult(const char* tableName, const char* functionName) : LuaCallResult(tableName, functionName, nullptr) {}
+	};
 
 	class LuaScript final
 	{
@@ -55,15 +182,175 @@ namespace LuaLink
         
         template<typename _RetType, typename... _ArgTypes>
         _RetType CallMethod(const char* className, const char* fnName, _ArgTypes... args);
+        
+        // // Same as above, but runs under the provided budget instead of the state's default budget
+        template<typename _RetType, typename... _ArgTypes>
+        _RetType CallFunction(const LuaBudget& budget, const char* fnName, _ArgTypes... args);
+        
+        template<typename _RetType, typename... _ArgTypes>
+        _RetType CallMethod(const LuaBudget& budget, const char* className, const char* fnName, _ArgTypes... args);
+        
+        // // Same as CallFunction/CallMethod, but failures are reported through the result instead of exceptions
+        // // Nothing is allocated unless the script raises an error, a missing function costs a single lookup
+        template<typename _RetType, typename... _ArgTypes>
+        LuaResult<_RetType> TryCallFunction(const char* fnName, _ArgTypes... args);
+        
+        template<typename _RetType, typename... _ArgTypes>
+        LuaResult<_RetType> TryCallMethod(const char* className, const char* fnName, _ArgTypes... args);
+        
+        template<typename _RetType, typename... _ArgTypes>
+        LuaResult<_RetType> TryCallFunction(const LuaBudget& budget, const char* fnName, _ArgTypes... args);
+        
+        template<typename _RetType, typename... _ArgTypes>
+        LuaResult<_RetType> TryCallMethod(const LuaBudget& budget, const char* className, const char* fnName, _ArgTypes... args);
+        
+        // // Classes registered with LUACLASS are only built when a script (or C++ pushing an object) first uses them,
+        // // instead of all of them during Initialize. Has to be set before Initialize
+        void SetLazyClassRegistration(bool isLazy);
+        
+        // // Lets require find modules in the bundle before looking for files, call between Load and Initialize
+        // // The bundle has to outlive the state, or be removed with RemoveBundle before it is closed
+        void AddBundle(const LuaBundle& bundle);
+        
+        // // Takes the searcher of the bundle out of package.searchers, does nothing if it wasn't added
+        // // Modules already loaded from it stay in package.loaded
+        void RemoveBundle(const LuaBundle& bundle);
+        
+        // // Compiles a script once, to run it in LuaSandbox environments (the state has to be loaded first)
+        LuaChunk LoadChunk(const char* filename);
+        LuaChunk LoadChunkString(const char* code, const char* chunkName = "=chunk");
+        
+        // // Exchanges values of variables registered with LuaVariable::RegisterSynced, call once per frame
+        // // Values assigned from Lua are copied back first, then variables marked dirty in C++ are written to Lua
+        void SyncVariables(void);
+        
+        // // Delivers all events queued with LuaEvents::Enqueue to their Lua handlers, in a single protected call
+        // // Throws a LuaCallException if a handler raises an error, events after the failing one stay queued
+        void DispatchEvents(void);
+        
+        // // Garbage collector tuning, returns false if this Lua version doesn't support the mode
+        bool SetGCMode(LuaGCMode mode);
+        // // Wait between cycles, in percent of the heap size after the previous cycle (Lua's default is 200)
+        void SetGCPause(int percent);
+        // // Speed of the collector relative to allocation, in percent (Lua's default is 200)
+        void SetGCStepMultiplier(int percent);
+        
+        // // Performs a step of about the given amount of work (in KB, 0 for a single basic step), returns true if it finished a cycle
+        bool StepGC(int kilobytes = 0);
+        // // Performs basic steps until maxMilliseconds have passed or a cycle finishes, use this to collect during idle time
+        bool StepGCFor(double maxMilliseconds);
+        // // Runs a full collection cycle
+        void CollectGarbage(void);
+        
+        // // Stop the collector around latency-critical sections, the heap grows until it is restarted
+        void StopGC(void);
+        void RestartGC(void);
+        bool IsGCRunning(void) const;
+        
+        // // Current size of the Lua heap in bytes
+        size_t GetHeapSize(void) const;
+        
+        const LuaGCStats& GetGCStats(void) const;
+        // // Most recent collection cycles, oldest first
+        const std::deque<LuaGCCycle>& GetGCHistory(void) const;
+        void ResetGCStats(void);
+        
+        // // Sets the budget for every call into this state (including the initial run) that doesn't provide its own
+        void SetBudget(const LuaBudget& budget);
+        const LuaBudget& GetBudget(void) const;
+        
+        // // Number of VM instructions between two budget checks, lower values abort sooner but cost more
+        void SetBudgetCheckInterval(int nrOfInstructions);
+        
+        const LuaBudgetStats& GetBudgetStats(void) const;
+        void ResetBudgetStats(void);
+        
+        // // Calls, errors, binding calls, exceptions, live objects and heap of the current state (since it was created)
+        // // Format or export them with LuaMetrics
+        LuaMetricsSnapshot GetMetrics(void) const;
+        // // Same, summed over every state since the process started (heap size and live objects are current)
+        static LuaMetricsSnapshot GetProcessMetrics(void);
 
 	private:
 		template<typename T> friend class LuaClass;
+		friend class LuaChunk;
+		friend class LuaSandbox;
+		friend class detail::CallbackRef;
         
         template<typename _RetType>
         struct Call;
         
+        //Makes a budget the active budget for the lifetime of this object
+        struct BudgetScope;
+        
+        //Counts a call, and its failure if it throws, in the metrics
+        template<typename _RetType, typename F>
+        static _RetType CountedCall(const char* tableName, const char* functionName, F call);
+        template<typename _RetType>
+        static LuaResult<_RetType> CountedTryCall(LuaResult<_RetType>&& result);
+        
+        //Metrics shared by GetMetrics and GetProcessMetrics
+        static void CollectMetrics(LuaMetricsSnapshot& snapshot, bool sinceStateCreated);
+        
+        //Bookkeeping for the budgeted call that is currently running
+        struct BudgetRun
+        {
+            const LuaBudget* pBudget;
+            std::chrono::steady_clock::time_point Start;
+            unsigned long long Executed;
+            int Interval;
+            bool IsActive;
+            bool IsExceeded;
+        };
+        
+        // // Wraps lua_pcall, enforces the active budget if there is one
+        static int ProtectedCall(int nrOfArgs, int nrOfResults);
+        
+        // // Count hook, aborts the running call once it goes over its budget
+        static void BudgetHook(lua_State* L, lua_Debug* ar);
+        
+        // // Replaces coroutine.resume and coroutine.wrap, so coroutines run under the budget of the call that resumes them
+        static void WrapCoroutines(lua_State* L);
+        static int BudgetResume(lua_State* L);
+        
+        static void RecordBudgetUsage(const LuaBudget& budget, double elapsedMs, bool isExceeded);
+        
+        // // Finalizer of an unreferenced userdata that is recreated every time it runs, so it runs once per collection cycle
+        static int GCSentinel(lua_State* L);
+        static void PushGCSentinel(lua_State* L);
+        
+        static void RecordGCStep(std::chrono::steady_clock::time_point start, const char* name);
+        
+        // // Accounts for memory owned by bound objects outside of the Lua heap, the collector is advanced as if it was allocated in Lua
+        static void AddExternalMemory(lua_State* L, size_t bytes);
+        static void RemoveExternalMemory(size_t bytes);
+        
+        // // Advances the collector by the pending external bytes, in whole KB
+        static void FlushExternalMemory(lua_State* L);
+        
 		//Returns lua_State* (to use when commiting classes)
 		static lua_State* GetLuaState(void);
+		
+		//Throws the error message on top of the stack as a LuaCallException, after restoring the stack to oldTop
+		static void ThrowCallError(int oldTop);
+		
+		//TryCall helpers: pushes the function (tableName may be nullptr), runs it and restores the stack to oldTop on failure
+		static LuaCallError PushCallable(LuaCallResult& result);
+		static LuaCallError RunCall(int oldTop, int nrOfArgs, int nrOfResults, std::string& scriptMessage);
+
+		//Lazy class registration: __index of the globals table, materializes a LUACLASS the first time it is named
+		static void InstallLazyClasses(lua_State* L);
+		static int LazyClassIndex(lua_State* L);
+		static void RegisterLazyClass(lua_State* L, int pendingIdx, const char* className);
+		
+		//Pushes package.searchers (package.loaders on Lua 5.1), or nil without the package library
+		static void PushSearchers(lua_State* L);
+		
+		//Materializes the pending LUACLASS registered through fn, so objects of it can be pushed before a script named it
+		static void RegisterPendingClass(void(*fn)(const char*, bool));
+
+		//Loads code so it takes its _ENV as argument, every run can use a different environment
+		static LuaChunk LoadSandboxedChunk(std::string code, const char* chunkName);
 
 		//Custom Lua allocator
 		static void* LuaAllocate(void *ud, void *ptr, size_t osize, size_t nsize);
@@ -74,6 +361,26 @@ namespace LuaLink
 		void(*InitializeEnvironment)(void); //Function where all needed variables/functions/classes are registeredd to the lua_State
 
 		static ::std::unique_ptr<lua_State> s_pLuaState;
+		
+		static LuaBudget s_Budget; //Default budget for this state
+		static const LuaBudget* s_pCallBudget; //Budget passed to the call that is being set up, overrides s_Budget
+		static int s_BudgetCheckInterval;
+		static BudgetRun s_BudgetRun;
+		static LuaBudgetStats s_BudgetStats;
+		
+		static LuaGCStats s_GCStats;
+		static std::deque<LuaGCCycle> s_GCHistory;
+		static std::chrono::steady_clock::time_point s_StateCreated;
+		static size_t s_HeapBytes; //Maintained by LuaAllocate
+		static size_t s_FreedBytes; //Freed by LuaAllocate since the last cycle
+		static bool s_IsGCStopped;
+		static size_t s_PendingExternalBytes; //Credited memory that hasn't advanced the collector yet
+		
+		static int s_CallDepth; //Calls into Lua currently running
+		static int s_PeakCallDepth;
+		static int s_PeakStackSize;
+		
+		static bool s_IsLazyClassRegistration;
 
 		//Disabling default copy constructor & assignment operator
 		LuaScript(const LuaScript& src) = delete;
@@ -16,50 +16,66 @@
 // along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <sstream>
+#include <climits>
+#include <fstream>
+#include <algorithm>
 #include <map>
 
 #include "LuaStack.hpp"
 #include "LuaClass.hpp"
 #include "LuaAuto.hpp"
+#include "LuaConstants.hpp"
+#include "LuaEvents.hpp"
 
 namespace LuaLink
 {
     struct LuaLoadException : public std::runtime_error
     {
-        explicit LuaLoadException(const char* msg):std::runtime_error(msg){}
+        explicit LuaLoadException(const char* msg):std::runtime_error(msg){ detail::Metrics::Increment(detail::Metrics::Exceptions); }
     };
     
     struct LuaCallException : public std::runtime_error
     {
-        explicit LuaCallException(const char* msg):std::runtime_error(msg){}
+        explicit LuaCallException(const char* msg):std::runtime_error(msg){ detail::Metrics::Increment(detail::Metrics::Exceptions); }
+    };
+    
+    //Thrown when a call was aborted because it went over its LuaBudget, the lua_State remains usable
+    struct LuaTimeoutException : public LuaCallException
+    {
+        explicit LuaTimeoutException(const char* msg):LuaCallException(msg){}
     };
 
 	#define LUA_STATE s_pLuaState.get()
 	
 	//Call implementations
-	template<typename _RetType> //1 return value
+	template<typename _RetType> //1 return value, or one per element of a std::tuple/std::pair
 	struct LuaScript::Call
 	{
 		template<typename... _ArgTypes>
 		static _RetType LuaFunction(const char* functionName, _ArgTypes... arguments)
 		{
+			int top = lua_gettop(LUA_STATE); //Restored on exit, so repeated calls don't grow the stack
+
 			//Look for global function with the provided name
 			lua_getglobal( LUA_STATE, functionName );
 			if( lua_type(LUA_STATE, lua_gettop(LUA_STATE)) == LUA_TNIL ){
-				lua_settop (LUA_STATE, 0);
+				lua_settop (LUA_STATE, top);
 				throw LuaCallException( ("Global not found: " + std::string(functionName) ).c_str() );
 			}
 
-			//Push arguments onto the Lua stack
+			int fnIdx = lua_gettop(LUA_STATE);
+
+			//Push arguments onto the Lua stack (tuples and pairs push several)
 			LuaStack::pushStack<_ArgTypes...>(LUA_STATE, arguments...);
 
 			//Perform function call
-			if (lua_pcall(LUA_STATE, sizeof...(_ArgTypes), 1, 0) != 0)
-					throw LuaCallException(lua_tostring(LUA_STATE, -1));
+			if (ProtectedCall(lua_gettop(LUA_STATE) - fnIdx, detail::ResultCount<_RetType>::value) != 0)
+				ThrowCallError(top);
 		
 			//Check return value
 			bool isOk = true;
-			auto ret = LuaStack::getVariable<_RetType>(LUA_STATE, -1, isOk);
+			auto ret = detail::Results<_RetType>::get(LUA_STATE, isOk);
+			lua_settop(LUA_STATE, top); //Pop return values (and the table we looked the function up in)
 			if(!isOk){
 				std::stringstream strstr;
 				strstr << "Error: Expected return type " << typeid(_RetType).name() << " does not match the value returned by " << functionName;
@@ -68,34 +84,65 @@ namespace LuaLink
 
 			return ret;
 		}
+		
+		template<typename... _ArgTypes>
+		static LuaResult<_RetType> TryCall(const char* tableName, const char* functionName, _ArgTypes... arguments)
+		{
+			LuaResult<_RetType> result(tableName, functionName);
+			int top = lua_gettop(LUA_STATE);
+			
+			result.m_Error = PushCallable(result);
+			if(result.m_Error != LuaCallError::None)
+				return result;
+			
+			int fnIdx = lua_gettop(LUA_STATE);
+			LuaStack::pushStack<_ArgTypes...>(LUA_STATE, arguments...);
+			
+			result.m_Error = RunCall(top, lua_gettop(LUA_STATE) - fnIdx, detail::ResultCount<_RetType>::value, result.m_ScriptMessage);
+			if(result.m_Error != LuaCallError::None)
+				return result;
+			
+			bool isOk = true;
+			result.m_Value = detail::Results<_RetType>::get(LUA_STATE, isOk);
+			lua_settop(LUA_STATE, top);
+			if(!isOk)
+				result.m_Error = LuaCallError::ReturnTypeMismatch;
+			
+			return result;
+		}
 	
 		template<typename... _ArgTypes>
 		static _RetType LuaStaticMethod(const char* tableName, const char* functionName, _ArgTypes... arguments)
 		{
+			int top = lua_gettop(LUA_STATE); //Restored on exit, so repeated calls don't grow the stack
+
 			//Look for global table with the provided name
 			lua_getglobal( LUA_STATE, tableName );
 			if( lua_type(LUA_STATE, lua_gettop(LUA_STATE)) == LUA_TNIL ){
-				lua_settop (LUA_STATE, 0);
+				lua_settop (LUA_STATE, top);
 				throw LuaCallException( ("Global not found: " + std::string(tableName) ).c_str() );
 			}
 
 			//Look for function in that table
 			lua_getfield(LUA_STATE, -1, functionName );
 			if(!lua_isfunction(LUA_STATE, -1)){
-				lua_settop (LUA_STATE, 0);
+				lua_settop (LUA_STATE, top);
 				throw LuaCallException( (std::string(functionName) + " is not a function in " + tableName).c_str() );
 			}
 
-			//Push arguments onto the Lua stack
+			int fnIdx = lua_gettop(LUA_STATE);
+
+			//Push arguments onto the Lua stack (tuples and pairs push several)
 			LuaStack::pushStack<_ArgTypes...>(LUA_STATE, arguments...);
 		
 			//Perform function call
-			if (lua_pcall(LUA_STATE, sizeof...(_ArgTypes), 1, 0) != 0)
-					throw LuaCallException(lua_tostring(LUA_STATE, -1));
+			if (ProtectedCall(lua_gettop(LUA_STATE) - fnIdx, detail::ResultCount<_RetType>::value) != 0)
+				ThrowCallError(top);
 
 			//Check return value
 			bool isOk = true;
-			auto ret = LuaStack::getVariable<_RetType>(LUA_STATE, -1, isOk);
+			auto ret = detail::Results<_RetType>::get(LUA_STATE, isOk);
+			lua_settop(LUA_STATE, top); //Pop return values (and the table we looked the function up in)
 			if(!isOk){
 				std::stringstream strstr;
 				strstr << "Error: Expected return type " << typeid(_RetType).name() << " does not match the value returned by " << tableName << "::" << functionName;
@@ -112,62 +159,206 @@ namespace LuaLink
 		template<typename... _ArgTypes>
 		static void LuaFunction(const char* functionName, _ArgTypes... arguments)
 		{
+			int top = lua_gettop(LUA_STATE); //Restored on exit, so repeated calls don't grow the stack
+
 			//Look for global function with the provided name
 			lua_getglobal( LUA_STATE, functionName );
 			if( lua_type(LUA_STATE, lua_gettop(LUA_STATE)) == LUA_TNIL ){
-				lua_settop (LUA_STATE, 0);
+				lua_settop (LUA_STATE, top);
 				throw LuaCallException( ("Global not found: " + std::string(functionName) ).c_str() );
 			}
 		
-			//Push arguments onto the Lua stack
+			int fnIdx = lua_gettop(LUA_STATE);
+
+			//Push arguments onto the Lua stack (tuples and pairs push several)
 			LuaStack::pushStack<_ArgTypes...>(LUA_STATE, arguments...);
 		
 			//Perform function call
-			if (lua_pcall(LUA_STATE, sizeof...(_ArgTypes), 0, 0) != 0)
-					throw LuaCallException(lua_tostring(LUA_STATE, -1));
+			if (ProtectedCall(lua_gettop(LUA_STATE) - fnIdx, 0) != 0)
+				ThrowCallError(top);
+			
+			lua_settop(LUA_STATE, top);
 		}
 	
 		template<typename... _ArgTypes>
 		static void LuaStaticMethod(const char* tableName, const char* functionName, _ArgTypes... arguments)
 		{
+			int top = lua_gettop(LUA_STATE); //Restored on exit, so repeated calls don't grow the stack
+
 			//Look for global table with the provided name
 			lua_getglobal( LUA_STATE, tableName );
 			if( lua_type(LUA_STATE, lua_gettop(LUA_STATE)) == LUA_TNIL ){
-				lua_settop (LUA_STATE, 0);
+				lua_settop (LUA_STATE, top);
 				throw LuaCallException( ("Global not found: " + std::string(tableName) ).c_str() );
 			}
 		
 			//Look for function in that table
 			lua_getfield(LUA_STATE, -1, functionName );
 			if(!lua_isfunction(LUA_STATE, -1)){
-				lua_settop (LUA_STATE, 0);
+				lua_settop (LUA_STATE, top);
 				throw LuaCallException( (std::string(functionName) + " is not a function in " + tableName).c_str() );
 			}
 		
-			//Push arguments onto the Lua stack
+			int fnIdx = lua_gettop(LUA_STATE);
+
+			//Push arguments onto the Lua stack (tuples and pairs push several)
 			LuaStack::pushStack<_ArgTypes...>(LUA_STATE, arguments...);
 		
 			//Perform function call
-			if (lua_pcall(LUA_STATE, sizeof...(_ArgTypes), 0, 0) != 0)
-					throw LuaCallException(lua_tostring(LUA_STATE, -1));
+			if (ProtectedCall(lua_gettop(LUA_STATE) - fnIdx, 0) != 0)
+				ThrowCallError(top);
+			
+			lua_settop(LUA_STATE, top);
+		}
+		
+		template<typename... _ArgTypes>
+		static LuaResult<void> TryCall(const char* tableName, const char* functionName, _ArgTypes... arguments)
+		{
+			LuaResult<void> result(tableName, functionName);
+			int top = lua_gettop(LUA_STATE);
+			
+			result.m_Error = PushCallable(result);
+			if(result.m_Error != LuaCallError::None)
+				return result;
+			
+			int fnIdx = lua_gettop(LUA_STATE);
+			LuaStack::pushStack<_ArgTypes...>(LUA_STATE, arguments...);
+			
+			result.m_Error = RunCall(top, lua_gettop(LUA_STATE) - fnIdx, 0, result.m_ScriptMessage);
+			lua_settop(LUA_STATE, top);
+			return result;
 		}
 	};
     
+    template<typename T>
+    const T& LuaResult<T>::Value(void) const
+    {
+        if(!IsOk())
+            throw LuaCallException(GetMessage().c_str());
+        return m_Value;
+    }
+    
+    template<typename _RetType, typename F>
+    _RetType LuaScript::CountedCall(const char* tableName, const char* functionName, F call)
+    {
+        detail::Trace::Scope traceScope(detail::Trace::Lua, tableName, functionName);
+        int counter = detail::Metrics::CallCounter(tableName, functionName);
+        detail::Metrics::Increment(counter);
+        
+        try{
+            return call();
+        }
+        catch(...){
+            detail::Metrics::Increment(counter + 1);
+            throw;
+        }
+    }
+    
+    template<typename _RetType>
+    LuaResult<_RetType> LuaScript::CountedTryCall(LuaResult<_RetType>&& result)
+    {
+        int counter = detail::Metrics::CallCounter(result.m_TableName, result.m_FunctionName);
+        detail::Metrics::Increment(counter);
+        if(!result.IsOk())
+            detail::Metrics::Increment(counter + 1);
+        return std::move(result);
+    }
+    
+    template<typename _RetType, typename... _ArgTypes>
+    LuaResult<_RetType> LuaScript::TryCallFunction(const char* fnName, _ArgTypes... args)
+    {
+        detail::Trace::Scope traceScope(detail::Trace::Lua, nullptr, fnName);
+        return CountedTryCall(LuaScript::Call<_RetType>::TryCall(nullptr, fnName, args...));
+    }
+    
+    template<typename _RetType, typename... _ArgTypes>
+    LuaResult<_RetType> LuaScript::TryCallMethod(const char* className, const char* fnName, _ArgTypes... args)
+    {
+        detail::Trace::Scope traceScope(detail::Trace::Lua, className, fnName);
+        return CountedTryCall(LuaScript::Call<_RetType>::TryCall(className, fnName, args...));
+    }
+    
     template<typename _RetType, typename... _ArgTypes>
     _RetType LuaScript::CallFunction(const char* fnName, _ArgTypes... args)
     {
-        return LuaScript::Call<_RetType>::LuaFunction(fnName, args...);
+        return CountedCall<_RetType>(nullptr, fnName, [&]() { return LuaScript::Call<_RetType>::LuaFunction(fnName, args...); });
     }
     
     template<typename _RetType, typename... _ArgTypes>
     _RetType LuaScript::CallMethod(const char* className, const char* fnName, _ArgTypes... args)
     {
-        return LuaScript::Call<_RetType>::LuaStaticMethod(className, fnName, args...);
+        return CountedCall<_RetType>(className, fnName, [&]() { return LuaScript::Call<_RetType>::LuaStaticMethod(className, fnName, args...); });
     }
     
+    struct LuaScript::BudgetScope
+    {
+        explicit BudgetScope(const LuaBudget& budget) : pPrevious(s_pCallBudget) { s_pCallBudget = &budget; }
+        ~BudgetScope(void) { s_pCallBudget = pPrevious; }
+        
+        const LuaBudget* pPrevious;
+    };
+    
+    template<typename _RetType, typename... _ArgTypes>
+    _RetType LuaScript::CallFunction(const LuaBudget& budget, const char* fnName, _ArgTypes... args)
+    {
+        BudgetScope scope(budget);
+        return CallFunction<_RetType>(fnName, args...);
+    }
+    
+    template<typename _RetType, typename... _ArgTypes>
+    _RetType LuaScript::CallMethod(const LuaBudget& budget, const char* className, const char* fnName, _ArgTypes... args)
+    {
+        BudgetScope scope(budget);
+        return CallMethod<_RetType>(className, fnName, args...);
+    }
+    
+    template<typename _RetType, typename... _ArgTypes>
+    LuaResult<_RetType> LuaScript::TryCallFunction(const LuaBudget& budget, const char* fnName, _ArgTypes... args)
+    {
+        BudgetScope scope(budget);
+        return TryCallFunction<_RetType>(fnName, args...);
+    }
+    
+    template<typename _RetType, typename... _ArgTypes>
+    LuaResult<_RetType> LuaScript::TryCallMethod(const LuaBudget& budget, const char* className, const char* fnName, _ArgTypes... args)
+    {
+        BudgetScope scope(budget);
+        return TryCallMethod<_RetType>(className, fnName, args...);
+    }
+    
+}
+
+//Included once the exceptions it throws are declared, the definitions below create chunks
+#include "LuaSandbox.hpp"
+#include "LuaBundle.hpp"
+
+namespace LuaLink
+{
 #ifdef LUALINK_DEFINE
     //Initialize static members
     std::unique_ptr<lua_State> LuaScript::s_pLuaState;
+    LuaBudget LuaScript::s_Budget;
+    const LuaBudget* LuaScript::s_pCallBudget = nullptr;
+    int LuaScript::s_BudgetCheckInterval = 1000;
+    LuaScript::BudgetRun LuaScript::s_BudgetRun = {};
+    LuaBudgetStats LuaScript::s_BudgetStats = {};
+    LuaGCStats LuaScript::s_GCStats = {};
+    std::deque<LuaGCCycle> LuaScript::s_GCHistory;
+    std::chrono::steady_clock::time_point LuaScript::s_StateCreated;
+    size_t LuaScript::s_HeapBytes = 0;
+    size_t LuaScript::s_FreedBytes = 0;
+    bool LuaScript::s_IsGCStopped = false;
+    size_t LuaScript::s_PendingExternalBytes = 0;
+    int LuaScript::s_CallDepth = 0;
+    int LuaScript::s_PeakCallDepth = 0;
+    int LuaScript::s_PeakStackSize = 0;
+    bool LuaScript::s_IsLazyClassRegistration = false;
+    
+    //Registry key of the table mapping names of classes that weren't used yet to their LuaAutoClass
+    static char s_PendingClassesKey;
+    
+    //Number of cycles kept in the GC history
+    static const size_t s_GCHistorySize = 256;
     
     //Constructor & destructor
     
@@ -183,10 +374,37 @@ namespace LuaLink
         
         //Allocate new lua_State if necessary
         if(bResetState || !s_pLuaState){
-            s_pLuaState = std::unique_ptr<lua_State>(lua_newstate(&LuaAllocate, nullptr)); //Unique pointer automatically destroys previous lua_State
+            //Keep the peaks of the previous state for the process metrics
+            if(s_pLuaState){
+                auto& peaks = detail::Metrics::ClosedStatePeaks();
+                peaks.HeapBytes = std::max(peaks.HeapBytes, s_GCStats.PeakHeapBytes);
+                peaks.CallDepth = std::max(peaks.CallDepth, s_PeakCallDepth);
+                peaks.StackSize = std::max(peaks.StackSize, s_PeakStackSize);
+            }
+            
+            s_pLuaState.reset(); //Close the previous state first, so the heap size only counts the new one
+            s_HeapBytes = 0;
+            s_pLuaState = std::unique_ptr<lua_State>(lua_newstate(&LuaAllocate, nullptr));
+            
+#ifdef LUAJIT_VERSION
+            //64-bit LuaJIT builds without GC64 only run on their own allocator
+            if(!s_pLuaState)
+                s_pLuaState = std::unique_ptr<lua_State>(luaL_newstate());
+#endif
             
             if(!s_pLuaState)
                 throw LuaLoadException("Error allocating new lua state");
+            
+            s_StateCreated = std::chrono::steady_clock::now();
+            s_PeakCallDepth = 0;
+            s_PeakStackSize = 0;
+            detail::Metrics::MarkStateCreated();
+            s_FreedBytes = 0;
+            s_IsGCStopped = false;
+            s_PendingExternalBytes = 0;
+            s_GCHistory.clear();
+            PushGCSentinel(LUA_STATE);
+            lua_pop(LUA_STATE, 1);
         }
         
         //Opens commonly used libraries
@@ -214,22 +432,37 @@ namespace LuaLink
         if(LUA_STATE == nullptr)
             Load();
         
-        LuaFunction::Release(); //Release any leftover functions
-        
         LuaAutoFunction::RegisterAll();
-        LuaAutoClass::RegisterAll();
+        LuaAutoConstants::RegisterAll();
+        if(s_IsLazyClassRegistration)
+            InstallLazyClasses(LUA_STATE);
+        else
+            LuaAutoClass::RegisterAll();
         
         if (InitializeEnvironment)
             InitializeEnvironment();
         
+        WrapCoroutines(LUA_STATE); //Hooks are per coroutine, the budget has to follow resumes
+        LuaEvents::Commit(LUA_STATE); //Events table, handlers subscribe during the initial run
         LuaFunction::Commit(LUA_STATE); //Commit all functions registered in 'InitializeEnvironment'
+        LuaConstants::Commit(LUA_STATE); //Constant tables, registered by LUACONSTANTS or in 'InitializeEnvironment'
+        LuaVariable::Sync(LUA_STATE); //Synced variables are visible to the initial run
         
         //Runs the script a first time to register functions and classes declared in the Lua script
-        switch(lua_pcall(LUA_STATE, 0, LUA_MULTRET, 0))
+        int status = 0;
+        {
+            detail::Trace::Scope traceScope(detail::Trace::Lua, nullptr, m_Filename);
+            status = ProtectedCall(0, LUA_MULTRET);
+        }
+        switch(status)
         {
             case 0:
                 break;
             case LUA_ERRRUN:
+                if(s_BudgetRun.IsExceeded)
+                    throw LuaTimeoutException(lua_tostring(LUA_STATE, -1));
+                throw LuaCallException(lua_tostring(LUA_STATE, -1));
+                break;
             case LUA_ERRMEM:
             case LUA_ERRERR:
                 throw LuaCallException(lua_tostring(LUA_STATE, -1));
@@ -261,6 +494,17 @@ namespace LuaLink
     {
         void *pOut = nullptr;
         
+        //Without a block, osize encodes the type of object being allocated
+        if(!ptr)
+            osize = 0;
+        
+        s_HeapBytes += nsize;
+        s_HeapBytes -= osize;
+        if(osize > nsize)
+            s_FreedBytes += osize - nsize;
+        else if(s_HeapBytes > s_GCStats.PeakHeapBytes)
+            s_GCStats.PeakHeapBytes = s_HeapBytes;
+        
         if (osize && nsize && ptr) {
             if (osize < nsize)
                 pOut = realloc (ptr, nsize);
@@ -279,6 +523,774 @@ namespace LuaLink
     {
         return LUA_STATE;
     }
+    
+    //Throws the error message on top of the stack as a LuaCallException, after restoring the stack to oldTop
+    void LuaScript::ThrowCallError(int oldTop)
+    {
+        std::string msg(lua_tostring(LUA_STATE, -1));
+        lua_settop(LUA_STATE, oldTop);
+        
+        if(s_BudgetRun.IsExceeded)
+            throw LuaTimeoutException(msg.c_str());
+        throw LuaCallException(msg.c_str());
+    }
+    
+    void LuaScript::SetLazyClassRegistration(bool isLazy)
+    {
+        s_IsLazyClassRegistration = isLazy;
+    }
+    
+    void LuaScript::InstallLazyClasses(lua_State* L)
+    {
+        lua_newtable(L);
+        for(auto elt = LuaAutoClass::GetAll(); elt != nullptr; elt = elt->cdr){
+            lua_pushlightuserdata(L, &elt->car);
+            lua_setfield(L, -2, elt->car.GetName());
+        }
+        
+        lua_pushvalue(L, -1);
+        lua_rawsetp(L, LUA_REGISTRYINDEX, &s_PendingClassesKey);
+        
+        //Chain to an __index the globals may already have
+        lua_pushglobaltable(L);
+        bool hasMetatable = lua_getmetatable(L, -1) != 0;
+        if(!hasMetatable)
+            lua_newtable(L);
+        lua_getfield(L, -1, "__index");
+        
+        //Upvalues: pending classes, previous __index, whether the metatable was created for the hook
+        lua_pushvalue(L, -4);
+        lua_insert(L, -2);
+        lua_pushboolean(L, !hasMetatable);
+        lua_pushcclosure(L, LazyClassIndex, 3);
+        lua_setfield(L, -2, "__index");
+        
+        lua_setmetatable(L, -2);
+        lua_pop(L, 2);
+    }
+    
+    int LuaScript::LazyClassIndex(lua_State* L)
+    {
+        if(lua_type(L, 2) == LUA_TSTRING){
+            lua_pushvalue(L, 2);
+            lua_rawget(L, lua_upvalueindex(1));
+            bool isPending = !lua_isnil(L, -1);
+            lua_pop(L, 1);
+            
+            if(isPending){
+                RegisterLazyClass(L, lua_upvalueindex(1), lua_tostring(L, 2));
+                lua_pushvalue(L, 2);
+                lua_rawget(L, 1);
+                return 1;
+            }
+        }
+        
+        //Not a class, fall back to the previous __index
+        switch(lua_type(L, lua_upvalueindex(2))){
+            case LUA_TFUNCTION:
+                lua_pushvalue(L, lua_upvalueindex(2));
+                lua_pushvalue(L, 1);
+                lua_pushvalue(L, 2);
+                lua_call(L, 2, 1);
+                return 1;
+            case LUA_TNIL:
+                lua_pushnil(L);
+                return 1;
+            default:
+                lua_pushvalue(L, 2);
+                lua_gettable(L, lua_upvalueindex(2));
+                return 1;
+        }
+    }
+    
+    void LuaScript::RegisterLazyClass(lua_State* L, int pendingIdx, const char* className)
+    {
+        pendingIdx = lua_absindex(L, pendingIdx);
+        
+        lua_getfield(L, pendingIdx, className);
+        auto pClass = static_cast<const LuaAutoClass*>(lua_touserdata(L, -1));
+        lua_pop(L, 1);
+        if(!pClass)
+            return;
+        
+        //Removed first, Register looks the class table up through the globals again
+        lua_pushnil(L);
+        lua_setfield(L, pendingIdx, className);
+        pClass->RegisterClass();
+        
+        lua_pushnil(L);
+        if(lua_next(L, pendingIdx) != 0){
+            lua_pop(L, 2);
+            return;
+        }
+        
+        //Every class is registered, take the hook out of the globals' metatable
+        lua_pushglobaltable(L);
+        if(lua_getmetatable(L, -1)){
+            lua_getfield(L, -1, "__index");
+            if(lua_tocfunction(L, -1) == LazyClassIndex){
+                lua_getupvalue(L, -1, 3);
+                bool isOwnMetatable = lua_toboolean(L, -1) != 0;
+                lua_pop(L, 1);
+                
+                lua_getupvalue(L, -1, 2);
+                lua_setfield(L, -3, "__index");
+                
+                //Drop the metatable if it only existed for the hook
+                if(isOwnMetatable){
+                    lua_pushnil(L);
+                    if(lua_next(L, -3) == 0){
+                        lua_pushnil(L);
+                        lua_setmetatable(L, -4);
+                    }
+                    else
+                        lua_pop(L, 2);
+                }
+            }
+            lua_pop(L, 2);
+        }
+        lua_pop(L, 1);
+    }
+    
+    void LuaScript::RegisterPendingClass(void(*fn)(const char*, bool))
+    {
+        lua_State* L = LUA_STATE;
+        if(!L || !s_IsLazyClassRegistration)
+            return;
+        
+        lua_rawgetp(L, LUA_REGISTRYINDEX, &s_PendingClassesKey);
+        if(lua_istable(L, -1)){
+            for(auto elt = LuaAutoClass::GetAll(); elt != nullptr; elt = elt->cdr){
+                if(elt->car.GetRegisterFunction() != fn)
+                    continue;
+                
+                lua_getfield(L, -1, elt->car.GetName());
+                bool isPending = !lua_isnil(L, -1);
+                lua_pop(L, 1);
+                
+                if(isPending)
+                    RegisterLazyClass(L, -1, elt->car.GetName());
+                break;
+            }
+        }
+        lua_pop(L, 1);
+    }
+    
+    void LuaScript::AddBundle(const LuaBundle& bundle)
+    {
+        if(!LUA_STATE)
+            throw LuaLoadException("Bundles can only be added to a loaded script");
+        
+        int top = lua_gettop(LUA_STATE);
+        
+        PushSearchers(LUA_STATE);
+        if(!lua_istable(LUA_STATE, -1)){
+            lua_settop(LUA_STATE, top);
+            throw LuaLoadException("Bundles need the package library, load the script with bOpenLibs");
+        }
+        
+        //Right after package.preload, before the searchers that open files
+        int nrOfSearchers = static_cast<int>(lua_rawlen(LUA_STATE, -1));
+        for(int i = nrOfSearchers; i >= 2; --i){
+            lua_rawgeti(LUA_STATE, -1, i);
+            lua_rawseti(LUA_STATE, -2, i + 1);
+        }
+        
+        lua_pushlightuserdata(LUA_STATE, const_cast<LuaBundle*>(&bundle));
+        lua_pushcclosure(LUA_STATE, LuaBundle::Searcher, 1);
+        lua_rawseti(LUA_STATE, -2, 2);
+        
+        lua_settop(LUA_STATE, top);
+    }
+    
+    void LuaScript::RemoveBundle(const LuaBundle& bundle)
+    {
+        if(!LUA_STATE)
+            return;
+        
+        int top = lua_gettop(LUA_STATE);
+        
+        PushSearchers(LUA_STATE);
+        if(!lua_istable(LUA_STATE, -1)){
+            lua_settop(LUA_STATE, top);
+            return;
+        }
+        
+        int nrOfSearchers = static_cast<int>(lua_rawlen(LUA_STATE, -1));
+        for(int i = 1; i <= nrOfSearchers; ++i){
+            lua_rawgeti(LUA_STATE, -1, i);
+            bool isBundleSearcher = lua_tocfunction(LUA_STATE, -1) == LuaBundle::Searcher &&
+                                    lua_getupvalue(LUA_STATE, -1, 1) != nullptr &&
+                                    lua_touserdata(LUA_STATE, -1) == &bundle;
+            lua_settop(LUA_STATE, top + 1);
+            
+            if(!isBundleSearcher)
+                continue;
+            
+            //Shift the searchers after it down, like table.remove
+            for(int j = i; j < nrOfSearchers; ++j){
+                lua_rawgeti(LUA_STATE, -1, j + 1);
+                lua_rawseti(LUA_STATE, -2, j);
+            }
+            lua_pushnil(LUA_STATE);
+            lua_rawseti(LUA_STATE, -2, nrOfSearchers);
+            break;
+        }
+        
+        lua_settop(LUA_STATE, top);
+    }
+    
+    void LuaScript::PushSearchers(lua_State* L)
+    {
+        lua_getglobal(L, "package");
+        if(!lua_istable(L, -1))
+            return;
+        
+        lua_getfield(L, -1, "searchers");
+        if(!lua_istable(L, -1)){
+            lua_pop(L, 1);
+            lua_getfield(L, -1, "loaders"); //Lua 5.1 (LuaJIT)
+        }
+        lua_remove(L, -2);
+    }
+    
+    LuaChunk LuaScript::LoadChunk(const char* filename)
+    {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        if(!file)
+            throw LuaLoadException(("Unable to open " + std::string(filename)).c_str());
+        
+        std::stringstream code;
+        code << file.rdbuf();
+        return LoadSandboxedChunk(code.str(), ("@" + std::string(filename)).c_str());
+    }
+    
+    LuaChunk LuaScript::LoadChunkString(const char* code, const char* chunkName)
+    {
+        return LoadSandboxedChunk(code, chunkName);
+    }
+    
+    LuaChunk LuaScript::LoadSandboxedChunk(std::string code, const char* chunkName)
+    {
+        if(!LUA_STATE)
+            throw LuaLoadException("Chunks can only be loaded into a loaded script");
+        
+        //Precompiled chunks (LUA_SIGNATURE) can't take their environment as argument
+        if(!code.empty() && code[0] == '\033')
+            throw LuaLoadException(("Precompiled chunks can't run in a sandbox: " + std::string(chunkName)).c_str());
+        
+        //Drop a shebang line but keep its line break, so line numbers in error messages stay the same
+        if(!code.empty() && code[0] == '#')
+            code.erase(0, std::min(code.find('\n'), code.size()));
+        
+#if LUA_VERSION_NUM >= 502
+        //A local _ENV per run, functions defined by the chunk keep the environment of the run that created them
+        code.insert(0, "local _ENV = ...; ");
+#endif
+        
+        if(luaL_loadbuffer(LUA_STATE, code.data(), code.size(), chunkName) != 0){
+            std::string msg(lua_tostring(LUA_STATE, -1));
+            lua_pop(LUA_STATE, 1);
+            throw LuaLoadException(msg.c_str());
+        }
+        
+        LuaChunk chunk;
+        chunk.m_Ref = luaL_ref(LUA_STATE, LUA_REGISTRYINDEX);
+        chunk.m_pLuaState = LUA_STATE;
+        return chunk;
+    }
+    
+    void LuaScript::SyncVariables(void)
+    {
+        if(LUA_STATE)
+            LuaVariable::Sync(LUA_STATE);
+    }
+    
+    void LuaScript::DispatchEvents(void)
+    {
+        if(!LUA_STATE || !LuaEvents::BeginDispatch())
+            return;
+        
+        int top = lua_gettop(LUA_STATE);
+        lua_pushcfunction(LUA_STATE, LuaEvents::DispatchBatch);
+        
+        bool hasFailed = false;
+        {
+            detail::Trace::Scope traceScope(detail::Trace::Lua, nullptr, "DispatchEvents");
+            hasFailed = ProtectedCall(0, 0) != 0;
+        }
+        LuaEvents::EndDispatch(hasFailed);
+        
+        if(hasFailed)
+            ThrowCallError(top);
+    }
+    
+    //TryCall
+    
+    LuaCallError LuaScript::PushCallable(LuaCallResult& result)
+    {
+        const char* tableName = result.m_TableName;
+        const char* functionName = result.m_FunctionName;
+        int top = lua_gettop(LUA_STATE);
+        
+        if(tableName){
+            lua_getglobal(LUA_STATE, tableName);
+            if(lua_isnil(LUA_STATE, -1)){
+                lua_settop(LUA_STATE, top);
+                return LuaCallError::NotFound;
+            }
+            //Indexing anything else could raise outside of a protected call
+            if(!lua_istable(LUA_STATE, -1)){
+                lua_settop(LUA_STATE, top);
+                return LuaCallError::NotATable;
+            }
+            
+            result.m_IsTableFound = true;
+            lua_getfield(LUA_STATE, -1, functionName);
+        }
+        else
+            lua_getglobal(LUA_STATE, functionName);
+        
+        if(lua_isnil(LUA_STATE, -1)){
+            lua_settop(LUA_STATE, top);
+            return LuaCallError::NotFound;
+        }
+        
+        if(!lua_isfunction(LUA_STATE, -1)){
+            lua_settop(LUA_STATE, top);
+            return LuaCallError::NotAFunction;
+        }
+        
+        return LuaCallError::None;
+    }
+    
+    LuaCallError LuaScript::RunCall(int oldTop, int nrOfArgs, int nrOfResults, std::string& scriptMessage)
+    {
+        int status = ProtectedCall(nrOfArgs, nrOfResults);
+        if(status == 0)
+            return LuaCallError::None;
+        
+        const char* msg = lua_tostring(LUA_STATE, -1);
+        scriptMessage = msg ? msg : "";
+        lua_settop(LUA_STATE, oldTop);
+        
+        if(s_BudgetRun.IsExceeded)
+            return LuaCallError::Timeout;
+        return status == LUA_ERRMEM ? LuaCallError::OutOfMemory : LuaCallError::Runtime;
+    }
+    
+    std::string LuaCallResult::GetMessage(void) const
+    {
+        switch(m_Error)
+        {
+            case LuaCallError::None:
+                return std::string();
+            case LuaCallError::NotFound:
+                if(m_IsTableFound)
+                    return "Function not found: " + std::string(m_TableName) + "." + m_FunctionName;
+                return "Global not found: " + std::string(m_TableName ? m_TableName : m_FunctionName);
+            case LuaCallError::NotATable:
+                return std::string(m_TableName) + " is not a table";
+            case LuaCallError::NotAFunction:
+                if(m_TableName)
+                    return std::string(m_FunctionName) + " is not a function in " + m_TableName;
+                return std::string(m_FunctionName) + " is not a function";
+            case LuaCallError::ReturnTypeMismatch:
+                {
+                    std::stringstream strstr;
+                    strstr << "Error: Expected return type " << m_pReturnType->name() << " does not match the value returned by ";
+                    if(m_TableName)
+                        strstr << m_TableName << "::";
+                    strstr << m_FunctionName;
+                    return strstr.str();
+                }
+            default:
+                return m_ScriptMessage;
+        }
+    }
+    
+    //Budgets
+    
+    void LuaScript::SetBudget(const LuaBudget& budget)
+    {
+        s_Budget = budget;
+    }
+    
+    const LuaBudget& LuaScript::GetBudget(void) const
+    {
+        return s_Budget;
+    }
+    
+    void LuaScript::SetBudgetCheckInterval(int nrOfInstructions)
+    {
+        s_BudgetCheckInterval = nrOfInstructions > 0 ? nrOfInstructions : 1;
+    }
+    
+    const LuaBudgetStats& LuaScript::GetBudgetStats(void) const
+    {
+        return s_BudgetStats;
+    }
+    
+    void LuaScript::ResetBudgetStats(void)
+    {
+        s_BudgetStats = LuaBudgetStats();
+    }
+    
+    //Metrics
+    
+    LuaMetricsSnapshot LuaScript::GetMetrics(void) const
+    {
+        LuaMetricsSnapshot snapshot = {};
+        CollectMetrics(snapshot, true);
+        return snapshot;
+    }
+    
+    LuaMetricsSnapshot LuaScript::GetProcessMetrics(void)
+    {
+        LuaMetricsSnapshot snapshot = {};
+        CollectMetrics(snapshot, false);
+        
+        auto& peaks = detail::Metrics::ClosedStatePeaks();
+        snapshot.PeakHeapBytes = std::max(snapshot.PeakHeapBytes, peaks.HeapBytes);
+        snapshot.PeakCallDepth = std::max(snapshot.PeakCallDepth, peaks.CallDepth);
+        snapshot.PeakStackSize = std::max(snapshot.PeakStackSize, peaks.StackSize);
+        return snapshot;
+    }
+    
+    void LuaScript::CollectMetrics(LuaMetricsSnapshot& snapshot, bool sinceStateCreated)
+    {
+        detail::Metrics::Collect(snapshot, sinceStateCreated);
+        
+        if(!s_pLuaState)
+            return;
+        
+        snapshot.HeapBytes = s_HeapBytes;
+        snapshot.PeakHeapBytes = s_GCStats.PeakHeapBytes;
+        snapshot.PeakCallDepth = s_PeakCallDepth;
+        snapshot.PeakStackSize = s_PeakStackSize;
+    }
+    
+    //Garbage collector
+    
+    bool LuaScript::SetGCMode(LuaGCMode mode)
+    {
+#if defined(LUA_GCGEN) && LUA_VERSION_NUM >= 504
+        lua_gc(LUA_STATE, mode == LuaGCMode::Generational ? LUA_GCGEN : LUA_GCINC, 0, 0, 0); //0 keeps the current parameters
+        return true;
+#elif defined(LUA_GCGEN)
+        lua_gc(LUA_STATE, mode == LuaGCMode::Generational ? LUA_GCGEN : LUA_GCINC, 0);
+        return true;
+#else
+        return mode == LuaGCMode::Incremental;
+#endif
+    }
+    
+    void LuaScript::SetGCPause(int percent)
+    {
+        lua_gc(LUA_STATE, LUA_GCSETPAUSE, percent);
+    }
+    
+    void LuaScript::SetGCStepMultiplier(int percent)
+    {
+        lua_gc(LUA_STATE, LUA_GCSETSTEPMUL, percent);
+    }
+    
+    bool LuaScript::StepGC(int kilobytes)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool isCycleFinished = lua_gc(LUA_STATE, LUA_GCSTEP, kilobytes) != 0;
+        RecordGCStep(start, "StepGC");
+        
+        return isCycleFinished;
+    }
+    
+    bool LuaScript::StepGCFor(double maxMilliseconds)
+    {
+        auto start = std::chrono::steady_clock::now();
+        
+        bool isCycleFinished = false;
+        do
+            isCycleFinished = lua_gc(LUA_STATE, LUA_GCSTEP, 0) != 0;
+        while(!isCycleFinished && std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < maxMilliseconds);
+        
+        RecordGCStep(start, "StepGCFor");
+        return isCycleFinished;
+    }
+    
+    void LuaScript::CollectGarbage(void)
+    {
+        auto start = std::chrono::steady_clock::now();
+        lua_gc(LUA_STATE, LUA_GCCOLLECT, 0);
+        RecordGCStep(start, "CollectGarbage");
+    }
+    
+    void LuaScript::StopGC(void)
+    {
+        lua_gc(LUA_STATE, LUA_GCSTOP, 0);
+        s_IsGCStopped = true;
+    }
+    
+    void LuaScript::RestartGC(void)
+    {
+        lua_gc(LUA_STATE, LUA_GCRESTART, 0);
+        s_IsGCStopped = false;
+        FlushExternalMemory(LUA_STATE); //Credited while stopped
+    }
+    
+    //Tracked here, LUA_GCISRUNNING isn't available in every Lua version
+    bool LuaScript::IsGCRunning(void) const
+    {
+        return !s_IsGCStopped;
+    }
+    
+    size_t LuaScript::GetHeapSize(void) const
+    {
+        return static_cast<size_t>(lua_gc(LUA_STATE, LUA_GCCOUNT, 0)) * 1024 + static_cast<size_t>(lua_gc(LUA_STATE, LUA_GCCOUNTB, 0));
+    }
+    
+    const LuaGCStats& LuaScript::GetGCStats(void) const
+    {
+        return s_GCStats;
+    }
+    
+    const std::deque<LuaGCCycle>& LuaScript::GetGCHistory(void) const
+    {
+        return s_GCHistory;
+    }
+    
+    void LuaScript::ResetGCStats(void)
+    {
+        size_t externalBytes = s_GCStats.ExternalBytes;
+        s_GCStats = LuaGCStats();
+        s_GCStats.PeakHeapBytes = s_HeapBytes;
+        s_GCStats.ExternalBytes = externalBytes;
+        s_GCHistory.clear();
+    }
+    
+    int LuaScript::GCSentinel(lua_State* L)
+    {
+        //The state is being closed, don't record the cycle or rearm
+        if(L != LUA_STATE)
+            return 0;
+        lua_getfield(L, LUA_REGISTRYINDEX, "LuaLink.Closing");
+        bool isClosing = lua_toboolean(L, -1) != 0;
+        lua_pop(L, 1);
+        if(isClosing)
+            return 0;
+        
+        ++s_GCStats.Collections;
+        detail::Metrics::Increment(detail::Metrics::GCCycles);
+        detail::Trace::Record(detail::Trace::GC, nullptr, "GC cycle", detail::Trace::Now(), 'i');
+        s_GCStats.BytesFreedLastCycle = s_FreedBytes;
+        s_FreedBytes = 0;
+        
+        LuaGCCycle cycle = { std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s_StateCreated).count(),
+                             static_cast<size_t>(lua_gc(L, LUA_GCCOUNT, 0)) * 1024 + static_cast<size_t>(lua_gc(L, LUA_GCCOUNTB, 0)),
+                             s_GCStats.BytesFreedLastCycle };
+        if(s_GCHistory.size() == s_GCHistorySize)
+            s_GCHistory.pop_front();
+        s_GCHistory.push_back(cycle);
+        
+        //Rearm for the next cycle
+        PushGCSentinel(L);
+        lua_pop(L, 1);
+        return 0;
+    }
+    
+    //A userdata rather than a table, LuaJIT only runs finalizers of userdata
+    void LuaScript::PushGCSentinel(lua_State* L)
+    {
+        lua_newuserdata(L, 1);
+        if(luaL_newmetatable(L, "LuaLink.GCSentinel")){
+            lua_pushcfunction(L, GCSentinel);
+            lua_setfield(L, -2, "__gc");
+        }
+        lua_setmetatable(L, -2);
+    }
+    
+    void LuaScript::RecordGCStep(std::chrono::steady_clock::time_point start, const char* name)
+    {
+        detail::Trace::Record(detail::Trace::GC, nullptr, name, static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count()));
+        
+        double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        
+        ++s_GCStats.Steps;
+        s_GCStats.StepMilliseconds += elapsedMs;
+        if(elapsedMs > s_GCStats.PeakStepMilliseconds)
+            s_GCStats.PeakStepMilliseconds = elapsedMs;
+    }
+    
+    void LuaScript::AddExternalMemory(lua_State* L, size_t bytes)
+    {
+        s_GCStats.ExternalBytes += bytes;
+        s_PendingExternalBytes += bytes;
+        
+        //A step runs the collector even while it is stopped (on every version), the bytes are flushed by RestartGC
+        if(s_IsGCStopped)
+            return;
+        FlushExternalMemory(L);
+    }
+    
+    void LuaScript::FlushExternalMemory(lua_State* L)
+    {
+        if(s_PendingExternalBytes < 1024)
+            return;
+        
+        //LUA_GCSTEP with a size adds that many KB to the collector's debt, as if they were allocated
+        size_t kilobytes = s_PendingExternalBytes / 1024;
+        if(kilobytes > static_cast<size_t>(INT_MAX))
+            kilobytes = static_cast<size_t>(INT_MAX);
+        s_PendingExternalBytes -= kilobytes * 1024;
+        
+        lua_gc(L, LUA_GCSTEP, static_cast<int>(kilobytes));
+    }
+    
+    //Lua's collector can't be credited back, the next cycle starts from the smaller heap once the object is gone
+    void LuaScript::RemoveExternalMemory(size_t bytes)
+    {
+        s_GCStats.ExternalBytes -= bytes < s_GCStats.ExternalBytes ? bytes : s_GCStats.ExternalBytes;
+    }
+    
+    // // Wraps lua_pcall, enforces the active budget if there is one
+    int LuaScript::ProtectedCall(int nrOfArgs, int nrOfResults)
+    {
+        //High-water marks for the metrics
+        struct DepthScope
+        {
+            DepthScope(void) { s_PeakCallDepth = std::max(s_PeakCallDepth, ++s_CallDepth); }
+            ~DepthScope(void) { --s_CallDepth; }
+        } depthScope;
+        s_PeakStackSize = std::max(s_PeakStackSize, lua_gettop(LUA_STATE));
+        
+        const LuaBudget& budget = s_pCallBudget ? *s_pCallBudget : s_Budget;
+        
+        //Nested calls (C++ -> Lua -> C++ -> Lua) are covered by the budget of the outermost call
+        if(s_BudgetRun.IsActive || !budget.IsLimited()){
+            if(!s_BudgetRun.IsActive)
+                s_BudgetRun.IsExceeded = false;
+            return lua_pcall(LUA_STATE, nrOfArgs, nrOfResults, 0);
+        }
+        
+        //Check at least once per instruction budget, so short budgets aren't overshot by a whole interval
+        int interval = s_BudgetCheckInterval;
+        if(budget.MaxInstructions != 0 && budget.MaxInstructions < static_cast<unsigned long long>(interval))
+            interval = static_cast<int>(budget.MaxInstructions);
+        
+        s_BudgetRun.pBudget = &budget;
+        s_BudgetRun.Start = std::chrono::steady_clock::now();
+        s_BudgetRun.Executed = 0;
+        s_BudgetRun.Interval = interval;
+        s_BudgetRun.IsActive = true;
+        s_BudgetRun.IsExceeded = false;
+        
+        lua_sethook(LUA_STATE, BudgetHook, LUA_MASKCOUNT, interval);
+        int status = lua_pcall(LUA_STATE, nrOfArgs, nrOfResults, 0);
+        lua_sethook(LUA_STATE, nullptr, 0, 0);
+        
+        s_BudgetRun.IsActive = false;
+        s_BudgetRun.pBudget = nullptr; //Points to a budget of the caller
+        
+        double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s_BudgetRun.Start).count();
+        RecordBudgetUsage(budget, elapsedMs, s_BudgetRun.IsExceeded);
+        
+        return status;
+    }
+    
+    // // Count hook, aborts the running call once it goes over its budget
+    void LuaScript::BudgetHook(lua_State* L, lua_Debug* ar)
+    {
+        //Left on a coroutine by a budgeted call that has returned
+        if(!s_BudgetRun.IsActive){
+            lua_sethook(L, nullptr, 0, 0);
+            return;
+        }
+        
+        if(!s_BudgetRun.IsExceeded){
+            const LuaBudget& budget = *s_BudgetRun.pBudget;
+            s_BudgetRun.Executed += s_BudgetRun.Interval;
+            
+            if(budget.MaxInstructions != 0 && s_BudgetRun.Executed >= budget.MaxInstructions)
+                s_BudgetRun.IsExceeded = true;
+            else if(budget.MaxMilliseconds > 0.0 &&
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s_BudgetRun.Start).count() >= budget.MaxMilliseconds)
+                s_BudgetRun.IsExceeded = true;
+            
+            if(!s_BudgetRun.IsExceeded)
+                return;
+            
+            //From now on raise on every instruction, so the script can't pcall its way out of the timeout
+            lua_sethook(L, BudgetHook, LUA_MASKCOUNT, 1);
+        }
+        
+        luaL_error(L, "Script exceeded its execution budget");
+    }
+    
+    void LuaScript::WrapCoroutines(lua_State* L)
+    {
+        lua_getglobal(L, "coroutine");
+        if(!lua_istable(L, -1)){
+            lua_pop(L, 1);
+            return;
+        }
+        
+        //Initialize may run more than once on the same state
+        lua_getfield(L, -1, "resume");
+        if(!lua_isfunction(L, -1) || lua_tocfunction(L, -1) == BudgetResume){
+            lua_pop(L, 2);
+            return;
+        }
+        lua_pushcclosure(L, BudgetResume, 1);
+        lua_setfield(L, -2, "resume");
+        lua_pop(L, 1);
+        
+        //The original wrap resumes without going through coroutine.resume
+        static const char* s_Wrap =
+            "local create, resume, error = coroutine.create, coroutine.resume, error\n"
+            "local function results(ok, ...) if ok then return ... end error((...), 0) end\n"
+            "coroutine.wrap = function(f) local co = create(f) return function(...) return results(resume(co, ...)) end end\n";
+        if(luaL_loadstring(L, s_Wrap) != 0 || lua_pcall(L, 0, 0, 0) != 0)
+            lua_pop(L, 1);
+    }
+    
+    //Upvalue: the original coroutine.resume
+    int LuaScript::BudgetResume(lua_State* L)
+    {
+        //Covers coroutines created before the budgeted call, and unhooks those created during an earlier one
+        lua_State* pThread = lua_tothread(L, 1);
+        if(pThread){
+            if(s_BudgetRun.IsActive)
+                lua_sethook(pThread, BudgetHook, LUA_MASKCOUNT, s_BudgetRun.IsExceeded ? 1 : s_BudgetRun.Interval);
+            else
+                lua_sethook(pThread, nullptr, 0, 0);
+        }
+        
+        lua_pushvalue(L, lua_upvalueindex(1));
+        lua_insert(L, 1);
+        lua_call(L, lua_gettop(L) - 1, LUA_MULTRET);
+        return lua_gettop(L);
+    }
+    
+    void LuaScript::RecordBudgetUsage(const LuaBudget& budget, double elapsedMs, bool isExceeded)
+    {
+        ++s_BudgetStats.Calls;
+        
+        if(isExceeded){
+            ++s_BudgetStats.Timeouts;
+            return;
+        }
+        
+        double instructionUsage = budget.MaxInstructions != 0 ? static_cast<double>(s_BudgetRun.Executed) / budget.MaxInstructions : 0.0;
+        double timeUsage = budget.MaxMilliseconds > 0.0 ? elapsedMs / budget.MaxMilliseconds : 0.0;
+        
+        if(instructionUsage > s_BudgetStats.PeakInstructionUsage)
+            s_BudgetStats.PeakInstructionUsage = instructionUsage;
+        if(timeUsage > s_BudgetStats.PeakTimeUsage)
+            s_BudgetStats.PeakTimeUsage = timeUsage;
+        
+        double usage = instructionUsage > timeUsage ? instructionUsage : timeUsage;
+        int bucket = usage < 0.25 ? 0 : usage < 0.5 ? 1 : usage < 0.75 ? 2 : usage < 0.9 ? 3 : 4;
+        ++s_BudgetStats.UsageHistogram[bucket];
+    }
 #endif //LUALINK_DEFINE
 
 	#undef LUA_STATE
@@ -17,10 +17,37 @@
 
 #pragma once
 
-#include <lua.hpp>
+#include "LuaCompat.h"
+#include <limits>
+#include <type_traits>
+#include <tuple>
+#include <utility>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <optional>
+#define LUALINK_HAS_OPTIONAL 1
+#else
+#define LUALINK_HAS_OPTIONAL 0
+#endif
 
 namespace LuaLink
 {
+	// // What reading an integer that doesn't fit the C++ type does
+	enum class LuaOverflow
+	{
+		Reject, //The value doesn't match, checked bindings raise an argument error and overloads are skipped
+		Clamp, //Saturates at the limits of the type
+		Wrap //Keeps the low bits, like a static_cast
+	};
+
+	template<typename T>
+	// // Overflow policy of integer type T, specialize it (or use LUAOVERFLOW in LuaAuto.hpp) to change it
+	struct LuaOverflowPolicy
+	{
+		//Lua keeps integers above the signed maximum as negative numbers, unsigned types as wide as lua_Integer round-trip those
+		static const LuaOverflow value = std::is_unsigned<T>::value && sizeof(T) >= sizeof(lua_Integer) ? LuaOverflow::Wrap : LuaOverflow::Reject;
+	};
+
 	class LuaStack
 	{
     public:
@@ -50,6 +77,212 @@ namespace LuaLink
 		LuaStack(const LuaStack& src) = delete;
 		LuaStack& operator=(const LuaStack& src) = delete;
 	};
+	
+	namespace detail {
+		template<typename T, typename Enable = void>
+		// // Pushes values returned to Lua or passed to Lua, falls back to LuaStack::pushVariable
+		// // LuaClass.inl adds pointers to bound classes and std::shared_ptr
+		struct Pusher
+		{
+			static void push(lua_State* pLua, T data) { LuaStack::pushVariable<T>(pLua, data); }
+		};
+		
+		template<typename T>
+		// // Number of Lua values a T is pushed as, or read from (std::tuple and std::pair map to multiple values)
+		struct ResultCount
+		{
+			static const int value = 1;
+		};
+		
+		template<typename T, typename Enable = void>
+		// // Reads arguments and values returned from Lua, falls back to LuaStack::getVariable
+		// // LuaStruct.inl adds structs and std::vector
+		struct Getter
+		{
+			static T get(lua_State* pLua, int idx, bool& isOk) { return LuaStack::getVariable<T>(pLua, idx, isOk); }
+		};
+		
+		template<typename T>
+		// // Pushes the results of a call, or reads them after a call, ResultCount values
+		// // Only here std::tuple and std::pair are spread over several values, anywhere else they are array tables
+		struct Results
+		{
+			template<typename U>
+			static void push(lua_State* pLua, U&& data) { Pusher<T>::push(pLua, std::forward<U>(data)); }
+			static T get(lua_State* pLua, bool& isOk) { return Getter<T>::get(pLua, -1, isOk); }
+		};
+		
+		template<typename T>
+		// // Integer types other than bool, bool is read and pushed as a Lua boolean
+		struct IsInteger
+		{
+			static const bool value = std::is_integral<T>::value && !std::is_same<T, bool>::value;
+		};
+		
+		template<typename T>
+		// // Range checks between lua_Integer and integer type T
+		struct IntegerRange
+		{
+			//lua_Integer holds every value of a narrower type
+			static const bool isWide = sizeof(T) >= sizeof(lua_Integer);
+			
+			static bool isBelow(lua_Integer i) { return std::is_unsigned<T>::value ? i < 0 : !isWide && i < static_cast<lua_Integer>(std::numeric_limits<T>::min()); }
+			static bool isAbove(lua_Integer i) { return !isWide && i > static_cast<lua_Integer>(std::numeric_limits<T>::max()); }
+			
+			//Unsigned values above the largest lua_Integer
+			static bool exceedsLua(T value) { return std::is_unsigned<T>::value && isWide && value > static_cast<T>(std::numeric_limits<lua_Integer>::max()); }
+		};
+		
+		template<typename T>
+		// // Converts a Lua integer to T according to LuaOverflowPolicy<T>, isOk is set to false if it is rejected
+		T ToInteger(lua_Integer i, bool& isOk)
+		{
+			bool isBelow = IntegerRange<T>::isBelow(i);
+			if(!isBelow && !IntegerRange<T>::isAbove(i))
+				return static_cast<T>(i);
+			
+			switch(LuaOverflowPolicy<T>::value)
+			{
+				case LuaOverflow::Wrap:
+					return static_cast<T>(i);
+				case LuaOverflow::Clamp:
+					return isBelow ? std::numeric_limits<T>::min() : std::numeric_limits<T>::max();
+				default:
+					isOk = false;
+					return T();
+			}
+		}
+		
+		template<typename T>
+		// // Integers are read as lua_Integer (the integer subtype from Lua 5.3 on), never through a double
+		struct Getter<T, typename std::enable_if<IsInteger<T>::value>::type>
+		{
+			static T get(lua_State* pLua, int idx, bool& isOk)
+			{
+				int isnum;
+				lua_Integer i = lua_tointegerx(pLua, idx, &isnum);
+				isOk = isnum != 0;
+				
+				return isOk ? ToInteger<T>(i, isOk) : T();
+			}
+		};
+		
+		template<typename T>
+		struct Getter<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+		{
+			static T get(lua_State* pLua, int idx, bool& isOk)
+			{
+				int isnum;
+				lua_Number n = lua_tonumberx(pLua, idx, &isnum);
+				isOk = isnum != 0;
+				
+				return static_cast<T>(n);
+			}
+		};
+		
+		template<typename T>
+		// // Enums are read as their underlying type
+		struct Getter<T, typename std::enable_if<std::is_enum<T>::value>::type>
+		{
+			static T get(lua_State* pLua, int idx, bool& isOk) { return static_cast<T>(Getter<typename std::underlying_type<T>::type>::get(pLua, idx, isOk)); }
+		};
+		
+		template<typename T>
+		struct Pusher<T, typename std::enable_if<IsInteger<T>::value>::type>
+		{
+			static void push(lua_State* pLua, T data)
+			{
+				//Unless they wrap, unsigned values lua_Integer can't hold are pushed as floats
+				if(IntegerRange<T>::exceedsLua(data) && LuaOverflowPolicy<T>::value != LuaOverflow::Wrap)
+					lua_pushnumber(pLua, static_cast<lua_Number>(data));
+				else
+					lua_pushinteger(pLua, static_cast<lua_Integer>(data));
+			}
+		};
+		
+		template<typename T>
+		struct Pusher<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+		{
+			static void push(lua_State* pLua, T data) { lua_pushnumber(pLua, static_cast<lua_Number>(data)); }
+		};
+		
+		template<typename T>
+		struct Pusher<T, typename std::enable_if<std::is_enum<T>::value>::type>
+		{
+			static void push(lua_State* pLua, T data) { Pusher<typename std::underlying_type<T>::type>::push(pLua, static_cast<typename std::underlying_type<T>::type>(data)); }
+		};
+		
+		template<typename T>
+		// // std::optional parameters may be left out when they come last
+		struct IsOptional
+		{
+			static const bool value = false;
+		};
+		
+#if LUALINK_HAS_OPTIONAL
+		template<typename T>
+		struct IsOptional<std::optional<T>>
+		{
+			static const bool value = true;
+		};
+#endif
+		
+		template<typename... T>
+		// // Number of std::optional parameters at the end of a parameter list
+		struct TrailingOptionals
+		{
+			static const int value = 0;
+		};
+		
+		template<typename H, typename... T>
+		struct TrailingOptionals<H, T...>
+		{
+			static const int value = TrailingOptionals<T...>::value == static_cast<int>(sizeof...(T)) && IsOptional<typename std::decay<H>::type>::value ? TrailingOptionals<T...>::value + 1 : TrailingOptionals<T...>::value;
+		};
+		
+		template<typename... _ArgTypes>
+		// // Checks the number of arguments on the stack, trailing std::optional arguments left out read as none
+		inline bool CheckArgCount(lua_State* pLua, int argc)
+		{
+			const int total = static_cast<int>(sizeof...(_ArgTypes));
+			if(argc > total || argc < total - TrailingOptionals<_ArgTypes...>::value)
+				return false;
+			
+			//Indices above the top are only valid within the stack space
+			return argc == total || lua_checkstack(pLua, total - argc) != 0;
+		}
+		
+		template<typename T, typename Enable = void>
+		// // Reads arguments of trusted bindings without any checking, numbers are read inline
+		struct TrustedReader
+		{
+			static T get(lua_State* pLua, int idx) { bool isOk; return Getter<T>::get(pLua, idx, isOk); }
+		};
+		
+		template<typename T>
+		struct TrustedReader<T, typename std::enable_if<IsInteger<T>::value>::type>
+		{
+			static T get(lua_State* pLua, int idx) { return static_cast<T>(lua_tointeger(pLua, idx)); }
+		};
+		
+		template<typename T>
+		struct TrustedReader<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+		{
+			static T get(lua_State* pLua, int idx) { return static_cast<T>(lua_tonumber(pLua, idx)); }
+		};
+		
+		template<typename T>
+		struct TrustedReader<T, typename std::enable_if<std::is_enum<T>::value>::type>
+		{
+			static T get(lua_State* pLua, int idx) { return static_cast<T>(TrustedReader<typename std::underlying_type<T>::type>::get(pLua, idx)); }
+		};
+		
+		template<>
+		struct TrustedReader<bool>
+		{
+			static bool get(lua_State* pLua, int idx) { return lua_toboolean(pLua, idx) != 0; }
+		};
+	}
 }
 
 #include "LuaStack.inl"
@@ -23,8 +23,8 @@ namespace LuaLink
 	struct LuaStack::Implementation_pushStack<H, T...>{
 		static void pushStack(lua_State* pLua, H data, T... tailData) 
 		{ 
-			pushVariable<H>(pLua, data);
-            pushStack(pLua, tailData...);
+			detail::Pusher<H>::push(pLua, data);
+            LuaStack::pushStack(pLua, tailData...);
 		}
 	};
     
@@ -32,7 +32,7 @@ namespace LuaLink
     struct LuaStack::Implementation_pushStack<T>{
         static void pushStack(lua_State* pLua, T data)
         {
-            pushVariable<T>(pLua, data);
+            detail::Pusher<T>::push(pLua, data);
         }
     };
     
@@ -46,6 +46,141 @@ namespace LuaLink
 	{
 		Implementation_pushStack<T...>::pushStack(pLua, data...);
 	}
+	
+	namespace detail {
+		//std::tuple and std::pair map to multiple Lua values as the results of a call, read from consecutive stack slots
+		//Nested in anything else (arguments, vectors, struct fields, ...) they are arrays, so they take a single slot
+		
+		template<typename Tuple, int I = 0, bool Done = (I == std::tuple_size<Tuple>::value)>
+		struct TupleItems
+		{
+			typedef typename std::tuple_element<I, Tuple>::type Item;
+			
+			static void push(lua_State* pLua, const Tuple& data)
+			{
+				Pusher<Item>::push(pLua, std::get<I>(data));
+				TupleItems<Tuple, I + 1>::push(pLua, data);
+			}
+			
+			static void get(lua_State* pLua, int firstIdx, Tuple& data, bool& isOk)
+			{
+				std::get<I>(data) = Getter<Item>::get(pLua, firstIdx + I, isOk);
+				if(isOk)
+					TupleItems<Tuple, I + 1>::get(pLua, firstIdx, data, isOk);
+			}
+			
+			static void pushArray(lua_State* pLua, const Tuple& data)
+			{
+				Pusher<Item>::push(pLua, std::get<I>(data));
+				lua_rawseti(pLua, -2, I + 1);
+				TupleItems<Tuple, I + 1>::pushArray(pLua, data);
+			}
+			
+			static void getArray(lua_State* pLua, int tableIdx, Tuple& data, bool& isOk)
+			{
+				lua_rawgeti(pLua, tableIdx, I + 1);
+				std::get<I>(data) = Getter<Item>::get(pLua, -1, isOk);
+				lua_pop(pLua, 1);
+				if(isOk)
+					TupleItems<Tuple, I + 1>::getArray(pLua, tableIdx, data, isOk);
+			}
+		};
+		
+		template<typename Tuple, int I>
+		struct TupleItems<Tuple, I, true>
+		{
+			static void push(lua_State*, const Tuple&) {}
+			static void get(lua_State*, int, Tuple&, bool&) {}
+			static void pushArray(lua_State*, const Tuple&) {}
+			static void getArray(lua_State*, int, Tuple&, bool&) {}
+		};
+		
+		template<typename Tuple>
+		struct TupleResults
+		{
+			static void push(lua_State* pLua, const Tuple& data) { TupleItems<Tuple>::push(pLua, data); }
+			
+			static Tuple get(lua_State* pLua, bool& isOk)
+			{
+				Tuple result;
+				isOk = true;
+				TupleItems<Tuple>::get(pLua, lua_gettop(pLua) - std::tuple_size<Tuple>::value + 1, result, isOk);
+				return result;
+			}
+		};
+		
+		template<typename Tuple>
+		struct TupleArray
+		{
+			static void push(lua_State* pLua, const Tuple& data)
+			{
+				lua_createtable(pLua, static_cast<int>(std::tuple_size<Tuple>::value), 0);
+				TupleItems<Tuple>::pushArray(pLua, data);
+			}
+			
+			static Tuple get(lua_State* pLua, int idx, bool& isOk)
+			{
+				Tuple result;
+				isOk = lua_istable(pLua, idx) != 0;
+				if(isOk)
+					TupleItems<Tuple>::getArray(pLua, lua_absindex(pLua, idx), result, isOk);
+				return result;
+			}
+		};
+		
+		template<typename... T>
+		struct ResultCount<std::tuple<T...>> { static const int value = sizeof...(T); };
+		
+		template<typename A, typename B>
+		struct ResultCount<std::pair<A, B>> { static const int value = 2; };
+		
+		template<typename... T>
+		struct Results<std::tuple<T...>> : TupleResults<std::tuple<T...>> {};
+		
+		template<typename A, typename B>
+		struct Results<std::pair<A, B>> : TupleResults<std::pair<A, B>> {};
+		
+		template<typename... T>
+		struct Pusher<std::tuple<T...>> : TupleArray<std::tuple<T...>> {};
+		
+		template<typename A, typename B>
+		struct Pusher<std::pair<A, B>> : TupleArray<std::pair<A, B>> {};
+		
+		template<typename... T>
+		struct Getter<std::tuple<T...>> : TupleArray<std::tuple<T...>> {};
+		
+		template<typename A, typename B>
+		struct Getter<std::pair<A, B>> : TupleArray<std::pair<A, B>> {};
+		
+#if LUALINK_HAS_OPTIONAL
+		//std::optional maps to nil or a value
+		template<typename T>
+		struct Pusher<std::optional<T>>
+		{
+			static void push(lua_State* pLua, const std::optional<T>& data)
+			{
+				if(data)
+					Pusher<T>::push(pLua, *data);
+				else
+					lua_pushnil(pLua);
+			}
+		};
+		
+		template<typename T>
+		struct Getter<std::optional<T>>
+		{
+			static std::optional<T> get(lua_State* pLua, int idx, bool& isOk)
+			{
+				isOk = true;
+				if(lua_isnoneornil(pLua, idx))
+					return std::nullopt;
+				
+				auto value = Getter<T>::get(pLua, idx, isOk);
+				return isOk ? std::optional<T>(std::move(value)) : std::nullopt;
+			}
+		};
+#endif
+	}
 }
 
 #ifdef LUALINK_DEFINE
@@ -61,27 +196,7 @@ namespace LuaLink {
         const char* str = lua_tostring(pLua, varIdx);
         isOk = str != nullptr;
         
-        return std::string(str);
-    }
-    
-    template<>
-    int LuaStack::getVariable<int>(lua_State* pLua, int varIdx, bool& isOk)
-    {
-        int isnum;
-        lua_Integer i = lua_tointegerx(pLua, varIdx, &isnum);
-        isOk = isnum != 0;
-        
-        return static_cast<int>(i);
-    }
-    
-    template<>
-    unsigned int LuaStack::getVariable<unsigned int>(lua_State* pLua, int varIdx, bool& isOk)
-    {
-        int isnum;
-        lua_Unsigned u = (lua_Unsigned)lua_tointegerx(pLua, varIdx, &isnum);
-        isOk = isnum != 0;
-        
-        return static_cast<unsigned int>(u);
+        return isOk ? std::string(str) : std::string();
     }
     
     template<>
@@ -95,16 +210,6 @@ namespace LuaLink {
         return false;
     }
     
-    template<>
-    double LuaStack::getVariable<double>(lua_State* pLua, int varIdx, bool& isOk)
-    {
-        int isnum;
-        lua_Number d = lua_tonumberx(pLua, varIdx, &isnum);
-        isOk = isnum != 0;
-        
-        return static_cast<double>(d);
-    }
-    
     template<>
     void* LuaStack::getVariable<void*>(lua_State* pLua, int varIdx, bool& isOk)
     {
@@ -122,37 +227,39 @@ namespace LuaLink {
         return std::string(str);
     }
     
-    template<>
-    int LuaStack::getVariable<int>(lua_State* pLua, int varIdx)
-    {
-        return static_cast<int>(lua_tointeger(pLua, varIdx));
-    }
-    
-    template<>
-    unsigned int LuaStack::getVariable<unsigned int>(lua_State* pLua, int varIdx)
-    {
-        return static_cast<unsigned int>(lua_tointeger(pLua, varIdx));
-    }
-    
     template<>
     bool LuaStack::getVariable<bool>(lua_State* pLua, int varIdx)
     {
         return lua_toboolean(pLua, varIdx) == 0 ? false : true;
     }
     
-    template<>
-    double LuaStack::getVariable<double>(lua_State* pLua, int varIdx)
-    {
-        lua_Number d = lua_tonumber(pLua, varIdx);
-        return static_cast<double>(d);
-    }
-    
     template<>
     void* LuaStack::getVariable<void*>(lua_State* pLua, int varIdx)
     {
         return lua_touserdata(pLua, varIdx);
     }
     
+    //Numbers, the same readers and pushers bindings use
+    
+    #define LUALINK_NUMBER_TYPE(TYPE) \
+    template<> TYPE LuaStack::getVariable<TYPE>(lua_State* pLua, int varIdx, bool& isOk) { return detail::Getter<TYPE>::get(pLua, varIdx, isOk); } \
+    template<> TYPE LuaStack::getVariable<TYPE>(lua_State* pLua, int varIdx) { return detail::TrustedReader<TYPE>::get(pLua, varIdx); } \
+    template<> void LuaStack::pushVariable<TYPE>(lua_State* pLua, TYPE data) { detail::Pusher<TYPE>::push(pLua, data); }
+    LUALINK_NUMBER_TYPE(char)
+    LUALINK_NUMBER_TYPE(signed char)
+    LUALINK_NUMBER_TYPE(unsigned char)
+    LUALINK_NUMBER_TYPE(short)
+    LUALINK_NUMBER_TYPE(unsigned short)
+    LUALINK_NUMBER_TYPE(int)
+    LUALINK_NUMBER_TYPE(unsigned int)
+    LUALINK_NUMBER_TYPE(long)
+    LUALINK_NUMBER_TYPE(unsigned long)
+    LUALINK_NUMBER_TYPE(long long)
+    LUALINK_NUMBER_TYPE(unsigned long long)
+    LUALINK_NUMBER_TYPE(float)
+    LUALINK_NUMBER_TYPE(double)
+    #undef LUALINK_NUMBER_TYPE
+    
     //pushVariable
     
     template<>
@@ -179,36 +286,12 @@ namespace LuaLink {
         lua_pushlstring( pLua, reinterpret_cast<const char*>(data.c_str() ), (data.size()+1)*sizeof(wchar_t) );
     }
     
-    template<>
-    void LuaStack::pushVariable<int>(lua_State* pLua, int data)
-    {
-        lua_pushinteger(pLua,	static_cast<lua_Integer>(data) );
-    }
-    
-    template<>
-    void LuaStack::pushVariable<unsigned int>(lua_State* pLua, unsigned int data)
-    { 
-        lua_pushinteger(pLua, static_cast<lua_Integer>(data) );
-    }
-    
     template<> 
     void LuaStack::pushVariable<bool>(lua_State* pLua, bool data)
     { 
         lua_pushboolean(pLua, static_cast<int>(data) );
     }
     
-    template<> 
-    void LuaStack::pushVariable<float>(lua_State* pLua, float data)
-    { 
-        lua_pushnumber(pLua, static_cast<lua_Number>(data) );
-    }
-    
-    template<> 
-    void LuaStack::pushVariable<double>(lua_State* pLua, double data)
-    { 
-        lua_pushnumber(pLua, static_cast<lua_Number>(data) );
-    }
-    
     template<>
     void LuaStack::pushVariable<void*>(lua_State* pLua, void* data)
     {
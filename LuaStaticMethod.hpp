@@ -24,6 +24,10 @@ namespace LuaLink
 	//Forward declarations
 	template<typename T> class LuaClass;
 	template<typename T> class LuaMethod;
+	
+	namespace detail {
+		template<typename T, typename... _ArgTypes> struct InPlaceConstructor;
+	}
 
 	template<typename ClassT>
 	class LuaStaticMethod
@@ -33,6 +37,18 @@ namespace LuaLink
         // //Registers a static method of class ClassT to use in Lua
         static void Register(_RetType(*pFunc)(_ArgTypes...), const char* name);
         
+        template<typename _RetType, typename... _ArgTypes>
+        // //Registers a static method that reads its arguments without checks, see LuaFunction::RegisterTrusted
+        static void RegisterTrusted(_RetType(*pFunc)(_ArgTypes...), const char* name);
+        
+        template<typename F>
+        // //Registers a lambda or functor as static method, see LuaFunction::Register
+        static typename std::enable_if<std::is_class<typename std::decay<F>::type>::value>::type Register(F&& functor, const char* name);
+        
+        template<typename... _ArgTypes>
+        // //Registers the constructor ClassT(_ArgTypes...) as "new", objects are constructed inside their Lua userdata
+        static void RegisterConstructor(void);
+        
 	private:
 		//LuaClass and LuaMethod need more 'intimate access than we want to expose to the end user
 		friend class LuaClass<ClassT>;	
@@ -45,8 +61,8 @@ namespace LuaLink
 		static int(*s_OverloadedConstructorWrapper)(lua_State*, detail::WrapperDoubleArg, void*, detail::ArgErrorCbType onArgError);
 	
 		//Pushes all registered static methods to the provided lua_State*
-		static void Commit(lua_State* pLuaState, int metatable);
-		static void CommitConstructors(lua_State* pLuaState, int metatable, lua_CFunction ctorWrapper, int(*overloadedCtorWrapper)(lua_State*, detail::WrapperDoubleArg, void*, detail::ArgErrorCbType onArgError));
+		static void Commit(lua_State* pLuaState, int metatable, const char* className);
+		static void CommitConstructors(lua_State* pLuaState, int metatable, const char* className, lua_CFunction ctorWrapper, int(*overloadedCtorWrapper)(lua_State*, detail::WrapperDoubleArg, void*, detail::ArgErrorCbType onArgError));
 
 		//Will serve as callback from Lua when calling an overloaded constructor
 		static int OverloadedCTorDispatch(lua_State* L);
@@ -38,44 +38,54 @@ namespace LuaLink
                                                          reinterpret_cast<void*>(pFunc)));
 	}
     
-    namespace detail {
-        namespace LuaFunction {
-            extern std::vector<Unsafe_LuaFunc>& LuaFunctionTable();
-        }
-    }
+	template<typename ClassT>
+	template<typename _RetType, typename... _ArgTypes>
+	void LuaStaticMethod<ClassT>::RegisterTrusted(_RetType(*pFunc)(_ArgTypes...), const char* name)
+	{
+		auto it = s_LuaFunctionMap.find(name);
+		if( it == s_LuaFunctionMap.end() )
+            it = s_LuaFunctionMap.insert(make_pair(name, std::vector<detail::LuaFunction::Unsafe_LuaFunc>() ) ).first;
+	
+		//Overloads are dispatched through the checked wrapper
+        it->second.push_back(detail::LuaFunction::Unsafe_LuaFunc(detail::FunctionWrapper<_RetType, _ArgTypes...>::execute,
+                                                         detail::TrustedFunctionWrapper<_RetType, _ArgTypes...>::execute,
+                                                         reinterpret_cast<void*>(pFunc)));
+	}
+    
+	template<typename ClassT>
+	template<typename F>
+	typename std::enable_if<std::is_class<typename std::decay<F>::type>::value>::type LuaStaticMethod<ClassT>::Register(F&& functor, const char* name)
+	{
+		auto it = s_LuaFunctionMap.find(name);
+		if( it == s_LuaFunctionMap.end() )
+            it = s_LuaFunctionMap.insert(make_pair(name, std::vector<detail::LuaFunction::Unsafe_LuaFunc>() ) ).first;
 	
+        it->second.push_back(detail::LuaFunction::MakeFunctorFunc(std::forward<F>(functor)));
+	}
+    
 	template<typename ClassT>
-	void LuaStaticMethod<ClassT>::Commit(lua_State* pLuaState, int metatable)
+	template<typename... _ArgTypes>
+	void LuaStaticMethod<ClassT>::RegisterConstructor(void)
+	{
+		auto it = s_LuaFunctionMap.find("new");
+		if( it == s_LuaFunctionMap.end() )
+            it = s_LuaFunctionMap.insert(make_pair("new", std::vector<detail::LuaFunction::Unsafe_LuaFunc>() ) ).first;
+	
+		//Constructors are only called through ConstructorWrapper, so there is no single-arg wrapper or callback
+        it->second.push_back(detail::LuaFunction::Unsafe_LuaFunc(detail::InPlaceConstructor<ClassT, _ArgTypes...>::execute,
+                                                         nullptr,
+                                                         nullptr));
+	}
+    
+	template<typename ClassT>
+	void LuaStaticMethod<ClassT>::Commit(lua_State* pLuaState, int metatable, const char* className)
     {
         using namespace detail::LuaFunction;
         
 		for(auto& elem : s_LuaFunctionMap){
-			//No overloading
-			if(elem.second.size() == 1){
-				lua_pushstring(pLuaState, elem.first ); //Push function name
-
-				lua_pushlightuserdata(pLuaState, elem.second[0].pFunc); //Push callback
-				lua_pushcclosure(pLuaState, elem.second[0].pWrapperSingle, 1); //Push wrapper
-				
-				lua_settable(pLuaState, metatable); //Add entry to the Lua table
-				continue;
-			}
-		
-			//This function needs to be overloaded =>
-
-			//Move functions to lookup table
-			size_t startIdx = LuaFunctionTable().size();
-			size_t endIdx = startIdx + elem.second.size();
-
-            std::move(elem.second.begin(), elem.second.end(), std::insert_iterator<std::vector<Unsafe_LuaFunc>>(LuaFunctionTable(), LuaFunctionTable().end()));
-
 			lua_pushstring(pLuaState, elem.first); //Push function name
 		
-			//Push start and end indices of functions in lookup table (endIdx is one past last function, like .end() iterators)
-			lua_pushinteger(pLuaState, startIdx);
-			lua_pushinteger(pLuaState, endIdx);
-
-			lua_pushcclosure(pLuaState, LuaFunction::LuaFunctionDispatch, 2); //Push closure
+			PushOverloads(pLuaState, elem.second, LuaFunction::LuaFunctionDispatch, className, elem.first); //Push callback (or overloads) and wrapper
 
 			lua_settable(pLuaState, metatable); //Set table
 		}
@@ -83,10 +93,8 @@ namespace LuaLink
 	}
 
 	template<typename ClassT>
-	void LuaStaticMethod<ClassT>::CommitConstructors(lua_State* pLuaState, int metatable, lua_CFunction ctorWrapper, int(*overloadedCtorWrapper)(lua_State*, detail::WrapperDoubleArg, void*, detail::ArgErrorCbType onArgError))
+	void LuaStaticMethod<ClassT>::CommitConstructors(lua_State* pLuaState, int metatable, const char* className, lua_CFunction ctorWrapper, int(*overloadedCtorWrapper)(lua_State*, detail::WrapperDoubleArg, void*, detail::ArgErrorCbType onArgError))
     {
-        using detail::LuaFunction::LuaFunctionTable;
-        
 		s_OverloadedConstructorWrapper = overloadedCtorWrapper;
 
 		auto it = s_LuaFunctionMap.find("new");
@@ -99,7 +107,8 @@ namespace LuaLink
 		
 			lua_pushlightuserdata(pLuaState, reinterpret_cast<void*>(it->second[0].pWrapper)); //Push wrapper callback
 			lua_pushlightuserdata(pLuaState, it->second[0].pFunc); //Push callback
-			lua_pushcclosure(pLuaState, ctorWrapper, 2); //Push ctor wrapper
+			detail::Trace::PushName(pLuaState, className, "new"); //Push name for the tracer
+			lua_pushcclosure(pLuaState, ctorWrapper, 3); //Push ctor wrapper
 				
 			lua_settable(pLuaState, metatable); //Add entry to the Lua table
 
@@ -109,18 +118,10 @@ namespace LuaLink
 		
 		//This function needs to be overloaded =>
 
-		//Move functions to lookup table
-		size_t startIdx = LuaFunctionTable().size();
-		size_t endIdx = startIdx + it->second.size();
-
-        std::move(it->second.begin(), it->second.end(), std::insert_iterator<std::vector<detail::LuaFunction::Unsafe_LuaFunc>>(LuaFunctionTable(), LuaFunctionTable().end()));
-
 		lua_pushstring(pLuaState, "new"); //Push function name
 		
-		//Push start and end indices of functions in lookup table (endIdx is one past last function, like .end() iterators)
-		lua_pushinteger(pLuaState, startIdx);
-		lua_pushinteger(pLuaState, endIdx);
-
+		detail::LuaFunction::PushCallables(pLuaState, it->second); //Push overloads
+		detail::Trace::PushName(pLuaState, className, "new"); //Push name for the tracer
 		lua_pushcclosure(pLuaState, OverloadedCTorDispatch, 2); //Push closure
 
 		lua_settable(pLuaState, metatable); //Set table
@@ -131,15 +132,16 @@ namespace LuaLink
 	template<typename ClassT>
 	int LuaStaticMethod<ClassT>::OverloadedCTorDispatch(lua_State* L)
 	{
-        using detail::LuaFunction::LuaFunctionTable;
-        
-		//Get locations of valid constructors in our lookup table
-		auto startIdx = static_cast<int>( lua_tointeger( L, lua_upvalueindex(1) ) );
-		auto endIdx =	static_cast<int>( lua_tointeger( L, lua_upvalueindex(2) ) );
+		detail::Metrics::CountBindingCall();
+		detail::Trace::Scope traceScope(L, lua_upvalueindex(2));
+		
+		//Get valid constructors from our upvalue
+		size_t count = 0;
+		auto pOverloads = detail::LuaFunction::ToCallables<detail::LuaFunction::Unsafe_LuaFunc>(L, lua_upvalueindex(1), count);
 
 		//Try constructors until we find one that fits (in case of failure, they will return before allocating any memory)
-		for(auto i = startIdx; i < endIdx; ++i){
-			int ret = s_OverloadedConstructorWrapper(L, LuaFunctionTable()[i].pWrapper, LuaFunctionTable()[i].pFunc, LuaFunction::OverloadedErrorHandling);
+		for(size_t i = 0; i < count; ++i){
+			int ret = s_OverloadedConstructorWrapper(L, pOverloads[i].pWrapper, pOverloads[i].pFunc, LuaFunction::OverloadedErrorHandling);
 		
 			if(ret < 0)
 				continue;
@@ -0,0 +1,41 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "LuaStack.hpp"
+#include <vector>
+
+namespace LuaLink
+{
+	template<typename T>
+	// // Field list of a struct that crosses the boundary by value, as a table with one entry per field
+	// // Specialized by LUASTRUCT, visit calls v(name, self.field) for every LUAFIELD
+	struct LuaStructFields
+	{
+		static const bool value = false;
+	};
+
+	namespace detail {
+		//Visitors passed to LuaStructFields<T>::visit
+		struct StructFieldCounter;
+		struct StructFieldPusher;
+		struct StructFieldReader;
+	}
+}
+
+#include "LuaStruct.inl"
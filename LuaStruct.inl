@@ -0,0 +1,132 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <type_traits>
+
+namespace LuaLink
+{
+    namespace detail {
+        struct StructFieldCounter
+        {
+            int Count;
+            
+            template<typename F>
+            void operator()(const char*, F&) { ++Count; }
+        };
+        
+        struct StructFieldPusher
+        {
+            lua_State* L;
+            
+            template<typename F>
+            void operator()(const char* name, F& field)
+            {
+                Pusher<F>::push(L, field);
+                lua_setfield(L, -2, name);
+            }
+        };
+        
+        struct StructFieldReader
+        {
+            lua_State* L;
+            int TableIdx;
+            bool& IsOk;
+            
+            template<typename F>
+            void operator()(const char* name, F& field)
+            {
+                if(!IsOk)
+                    return;
+                
+                lua_getfield(L, TableIdx, name);
+                field = Getter<F>::get(L, -1, IsOk);
+                lua_pop(L, 1);
+            }
+        };
+        
+        //Structs are pushed as tables presized for their fields
+        template<typename T>
+        struct Pusher<T, typename std::enable_if<LuaStructFields<T>::value>::type>
+        {
+            static void push(lua_State* pLua, const T& data)
+            {
+                T& self = const_cast<T&>(data); //Visitors take fields by reference, pushing doesn't modify them
+                
+                static const int nrOfFields = [&]{ StructFieldCounter counter{0}; LuaStructFields<T>::visit(counter, self); return counter.Count; }();
+                lua_createtable(pLua, 0, nrOfFields);
+                
+                StructFieldPusher pusher{pLua};
+                LuaStructFields<T>::visit(pusher, self);
+            }
+        };
+        
+        template<typename T>
+        struct Getter<T, typename std::enable_if<LuaStructFields<T>::value>::type>
+        {
+            static T get(lua_State* pLua, int idx, bool& isOk)
+            {
+                T result = T();
+                isOk = lua_istable(pLua, idx) != 0;
+                if(!isOk)
+                    return result;
+                
+                StructFieldReader reader{pLua, lua_absindex(pLua, idx), isOk};
+                LuaStructFields<T>::visit(reader, result);
+                return result;
+            }
+        };
+        
+        //Vectors are pushed as arrays, of anything that can be pushed itself (including structs)
+        template<typename T>
+        struct Pusher<std::vector<T>>
+        {
+            static void push(lua_State* pLua, const std::vector<T>& data)
+            {
+                lua_createtable(pLua, static_cast<int>(data.size()), 0);
+                
+                for(size_t i = 0; i < data.size(); ++i){
+                    Pusher<T>::push(pLua, data[i]);
+                    lua_rawseti(pLua, -2, static_cast<int>(i + 1));
+                }
+            }
+        };
+        
+        template<typename T>
+        struct Getter<std::vector<T>>
+        {
+            static std::vector<T> get(lua_State* pLua, int idx, bool& isOk)
+            {
+                std::vector<T> result;
+                isOk = lua_istable(pLua, idx) != 0;
+                if(!isOk)
+                    return result;
+                
+                idx = lua_absindex(pLua, idx);
+                auto size = lua_rawlen(pLua, idx);
+                result.reserve(size);
+                
+                for(size_t i = 1; i <= size && isOk; ++i){
+                    lua_rawgeti(pLua, idx, static_cast<int>(i));
+                    result.push_back(Getter<T>::get(pLua, -1, isOk));
+                    lua_pop(pLua, 1);
+                }
+                
+                return result;
+            }
+        };
+    }
+}
@@ -0,0 +1,139 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include "LuaCompat.h"
+#include "LuaMetrics.hpp"
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace LuaLink
+{
+	// // Records calls into Lua, calls of bound C++ functions and garbage collection as Chrome trace events,
+	// // load the output in chrome://tracing or https://ui.perfetto.dev. Nothing is recorded until Start is called
+	class LuaTrace
+	{
+	public:
+		// // Every thread keeps its most recent eventsPerThread events, restarting discards all recorded events
+		static void Start(size_t eventsPerThread = 65536);
+		static void Stop(void);
+		static bool IsRecording(void);
+
+		// // Trace-event JSON of the events recorded since the previous flush, recording goes on
+		static std::string Flush(void);
+
+		// // Writes Flush() to a file, returns false if it couldn't be written
+		static bool FlushToFile(const char* filename);
+
+	private:
+		//Disable default constructor, destructor, copy constructor & assignment operator
+		LuaTrace(void) = delete;
+		~LuaTrace(void) = delete;
+		LuaTrace(const LuaTrace& src) = delete;
+		LuaTrace& operator=(const LuaTrace& src) = delete;
+	};
+
+	namespace detail {
+		namespace Trace {
+			enum Category : unsigned char
+			{
+				Lua, //C++ -> Lua
+				Binding, //Lua -> C++
+				GC
+			};
+
+			//64 bytes, longer names are truncated
+			struct Event
+			{
+				unsigned long long Start; //Nanoseconds on the steady clock
+				unsigned long long Duration;
+				char Phase; //'X' for spans, 'i' for instants
+				Category Cat;
+				char Name[46];
+			};
+
+			inline std::atomic<bool>& RecordingFlag(void)
+			{
+				static std::atomic<bool> s_IsRecording(false);
+				return s_IsRecording;
+			}
+
+			// Checked before anything else is done, so the tracer costs a relaxed load while it is off
+			inline bool IsRecording(void) { return RecordingFlag().load(std::memory_order_relaxed); }
+
+			inline unsigned long long Now(void)
+			{
+				return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+			}
+
+			// Appends an event to the calling thread's ring buffer, name is "tableName.name" if tableName isn't nullptr
+			void Record(Category category, const char* tableName, const char* name, unsigned long long start, char phase = 'X');
+
+			// Pushes the name a binding's closure carries as upvalue, Scope reads it back when the binding is called
+			void PushName(lua_State* L, const char* tableName, const char* name);
+
+			// Records a span from construction to destruction if recording when constructed,
+			// spans left by a Lua error (longjmp) are dropped
+			class Scope
+			{
+			public:
+				Scope(Category category, const char* tableName, const char* name) :
+					m_pTableName(tableName), m_pName(nullptr), m_Start(0), m_Category(category)
+				{
+					if(!IsRecording())
+						return;
+
+					m_pName = name;
+					m_Start = Now();
+				}
+
+				// Bound function, nameIdx is the upvalue pushed by PushName
+				Scope(lua_State* L, int nameIdx) :
+					m_pTableName(nullptr), m_pName(nullptr), m_Start(0), m_Category(Binding)
+				{
+					if(!IsRecording())
+						return;
+
+					m_pName = lua_tostring(L, nameIdx);
+					if(!m_pName)
+						m_pName = "(binding)";
+					m_Start = Now();
+				}
+
+				~Scope(void)
+				{
+					if(m_pName)
+						Record(m_Category, m_pTableName, m_pName, m_Start);
+				}
+
+			private:
+				const char* m_pTableName;
+				const char* m_pName;
+				unsigned long long m_Start;
+				Category m_Category;
+
+				Scope(const Scope& src) = delete;
+				Scope& operator=(const Scope& src) = delete;
+			};
+		}
+	}
+}
+
+#include "LuaTrace.inl"
@@ -0,0 +1,247 @@
+// Copyright � 2013 Tom Tondeur
+// 
+// This file is part of LuaLink.
+// 
+// LuaLink is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// LuaLink is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifdef LUALINK_DEFINE
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace LuaLink
+{
+	namespace detail {
+		namespace Trace {
+			// Ring buffer of one thread, only that thread writes events
+			struct ThreadBuffer
+			{
+				std::vector<Event> Events;
+				std::atomic<unsigned long long> Written; //Events written this session, Events[i % size] holds event i
+				unsigned long long Flushed; //Events handed out by Flush
+				unsigned Session; //Session the events belong to, changed by the owner under the registry lock
+				int ThreadId;
+				bool IsExited;
+			};
+
+			struct Registry
+			{
+				Registry(void) : Session(0), Capacity(0), SessionStart(0), NextThreadId(1) {}
+
+				std::mutex Mutex;
+				std::vector<ThreadBuffer*> Threads;
+				std::atomic<unsigned> Session;
+				size_t Capacity;
+				unsigned long long SessionStart;
+				int NextThreadId;
+			};
+
+			//Never destroyed, objects collected by lua_close during static destruction may still call bindings
+			static Registry& GetRegistry(void)
+			{
+				static Registry* s_pRegistry = new Registry();
+				return *s_pRegistry;
+			}
+
+			//Keeps the events of a thread that exits until the next Start, and stops it from recording more
+			struct ExitedBuffer
+			{
+				ThreadBuffer** ppBuffer;
+
+				~ExitedBuffer(void)
+				{
+					static ThreadBuffer* s_pDiscarded = new ThreadBuffer();
+					s_pDiscarded->IsExited = true;
+
+					auto& registry = GetRegistry();
+					std::lock_guard<std::mutex> lock(registry.Mutex);
+					(*ppBuffer)->IsExited = true;
+					*ppBuffer = s_pDiscarded;
+				}
+			};
+
+			static void CreateThreadBuffer(ThreadBuffer*& pBuffer)
+			{
+				pBuffer = new ThreadBuffer();
+				pBuffer->Written.store(0, std::memory_order_relaxed);
+				pBuffer->Flushed = 0;
+				pBuffer->Session = 0;
+				pBuffer->IsExited = false;
+				{
+					auto& registry = GetRegistry();
+					std::lock_guard<std::mutex> lock(registry.Mutex);
+					pBuffer->ThreadId = registry.NextThreadId++;
+					registry.Threads.push_back(pBuffer);
+				}
+
+				thread_local ExitedBuffer s_Exited = { &pBuffer };
+				(void)s_Exited;
+			}
+
+			static ThreadBuffer& Local(void)
+			{
+				thread_local ThreadBuffer* s_pBuffer = nullptr;
+				if(!s_pBuffer)
+					CreateThreadBuffer(s_pBuffer);
+				return *s_pBuffer;
+			}
+
+			//The only time a thread takes the lock, once per session
+			static void JoinSession(ThreadBuffer& buffer)
+			{
+				auto& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.Mutex);
+				buffer.Events.assign(registry.Capacity, Event());
+				buffer.Written.store(0, std::memory_order_relaxed);
+				buffer.Flushed = 0;
+				buffer.Session = registry.Session.load(std::memory_order_relaxed);
+			}
+
+			void Record(Category category, const char* tableName, const char* name, unsigned long long start, char phase)
+			{
+				if(!IsRecording())
+					return;
+
+				unsigned long long end = Now();
+				auto& buffer = Local();
+				if(buffer.IsExited)
+					return;
+				if(buffer.Session != GetRegistry().Session.load(std::memory_order_acquire))
+					JoinSession(buffer);
+				if(buffer.Events.empty())
+					return;
+
+				unsigned long long index = buffer.Written.load(std::memory_order_relaxed);
+				auto& event = buffer.Events[static_cast<size_t>(index % buffer.Events.size())];
+				event.Start = start;
+				event.Duration = end - start;
+				event.Phase = phase;
+				event.Cat = category;
+				if(tableName)
+					snprintf(event.Name, sizeof(event.Name), "%s.%s", tableName, name);
+				else
+					snprintf(event.Name, sizeof(event.Name), "%s", name);
+
+				//Publishes the event, Flush reads up to Written
+				buffer.Written.store(index + 1, std::memory_order_release);
+			}
+
+			void PushName(lua_State* L, const char* tableName, const char* name)
+			{
+				if(tableName)
+					lua_pushfstring(L, "%s.%s", tableName, name);
+				else
+					lua_pushstring(L, name);
+			}
+
+			//Caller holds the lock
+			static void FlushThread(std::ostream& out, ThreadBuffer& buffer, unsigned long long sessionStart, bool& isFirst)
+			{
+				const unsigned long long capacity = buffer.Events.size();
+				unsigned long long written = buffer.Written.load(std::memory_order_acquire);
+				unsigned long long first = std::max(buffer.Flushed, written > capacity ? written - capacity : 0ULL);
+				if(first == written)
+					return;
+
+				//The owner keeps writing unless it exited, events it overwrote while they were copied are dropped
+				std::vector<Event> events;
+				for(unsigned long long i = first; i < written; ++i)
+					events.push_back(buffer.Events[static_cast<size_t>(i % capacity)]);
+
+				unsigned long long rewritten = buffer.Written.load(std::memory_order_acquire);
+				size_t skipped = !buffer.IsExited && rewritten >= capacity && rewritten - capacity + 1 > first ? static_cast<size_t>(rewritten - capacity + 1 - first) : 0;
+				buffer.Flushed = written;
+
+				static const char* const s_Categories[] = { "lua", "binding", "gc" };
+				for(size_t i = skipped; i < events.size(); ++i){
+					auto& event = events[i];
+					event.Name[sizeof(event.Name) - 1] = '\0';
+
+					char timing[64];
+					if(event.Phase == 'X')
+						snprintf(timing, sizeof(timing), "\"ts\":%.3f,\"dur\":%.3f", (event.Start - sessionStart) / 1000.0, event.Duration / 1000.0);
+					else
+						snprintf(timing, sizeof(timing), "\"ts\":%.3f,\"s\":\"t\"", (event.Start - sessionStart) / 1000.0);
+
+					out << (isFirst ? "\n" : ",\n") << "{\"name\":\"" << Metrics::EscapeJson(event.Name) << "\",\"cat\":\"" << s_Categories[event.Cat]
+						<< "\",\"ph\":\"" << event.Phase << "\"," << timing << ",\"pid\":1,\"tid\":" << buffer.ThreadId << '}';
+					isFirst = false;
+				}
+			}
+		}
+	}
+
+	void LuaTrace::Start(size_t eventsPerThread)
+	{
+		auto& registry = detail::Trace::GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.Mutex);
+
+		//Threads that exited have nothing left to record
+		for(auto it = registry.Threads.begin(); it != registry.Threads.end();){
+			if(!(*it)->IsExited){
+				++it;
+				continue;
+			}
+			delete *it;
+			it = registry.Threads.erase(it);
+		}
+
+		registry.Capacity = eventsPerThread;
+		registry.SessionStart = detail::Trace::Now();
+		registry.Session.store(registry.Session.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		detail::Trace::RecordingFlag().store(true, std::memory_order_relaxed);
+	}
+
+	void LuaTrace::Stop(void)
+	{
+		detail::Trace::RecordingFlag().store(false, std::memory_order_relaxed);
+	}
+
+	bool LuaTrace::IsRecording(void)
+	{
+		return detail::Trace::IsRecording();
+	}
+
+	std::string LuaTrace::Flush(void)
+	{
+		auto& registry = detail::Trace::GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.Mutex);
+
+		std::ostringstream out;
+		out << "{\"traceEvents\":[";
+		bool isFirst = true;
+		for(auto pBuffer : registry.Threads)
+			if(pBuffer->Session == registry.Session.load(std::memory_order_relaxed))
+				detail::Trace::FlushThread(out, *pBuffer, registry.SessionStart, isFirst);
+		out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+		return out.str();
+	}
+
+	bool LuaTrace::FlushToFile(const char* filename)
+	{
+		std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+		if(!file)
+			return false;
+
+		file << Flush();
+		return file.good();
+	}
+}
+
+#endif
@@ -17,7 +17,7 @@
 
 #pragma once
 
-#include <lua.hpp>
+#include "LuaCompat.h"
 
 namespace LuaLink
 {
@@ -30,6 +30,15 @@ namespace LuaLink
 		// // Register a variable of type T, will be automatically registered for a class if done so in the appropriate member function
 		static void Register(T& var, const char* varName);
 
+		template<typename T>
+		// // Register a variable that is copied into a plain Lua global (or a field of the global table tableName) by LuaScript::SyncVariables
+		// // Scripts read it at table speed, assignments from Lua are copied back on the next sync
+		static void RegisterSynced(T& var, const char* varName, const char* tableName = nullptr);
+
+		template<typename T>
+		// // Marks a synced variable as changed in C++, so the next sync writes it to Lua
+		static void MarkDirty(const T& var) { MarkDirty_Impl(static_cast<const void*>(&var)); }
+
 	private:
 		//LuaScript and LuaClass need to trigger the actual commits to the lua_State
 		friend class LuaScript;
@@ -37,6 +46,11 @@ namespace LuaLink
 
 		// // Commits all registered variables to the lua_State, pass 0 to register as global, otherwise the index on the stack of the table to register variables for
 		static void Commit(lua_State* pLuaState, int tableIdx = 0);
+
+		// // Copies values assigned from Lua back into synced variables, then writes dirty ones to Lua
+		static void Sync(lua_State* pLuaState);
+
+		static void MarkDirty_Impl(const void* pVar);
 		
 		//Disable default constructor, destructor, copy constructor & assignment operator
 		LuaVariable(void) = delete;
@@ -15,7 +15,7 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with LuaLink.  If not, see <http://www.gnu.org/licenses/>.
 
-#include <lua.hpp>
+#include "LuaCompat.h"
 #include "LuaStack.hpp"
 
 namespace LuaLink
@@ -27,11 +27,21 @@ namespace LuaLink
             struct Implementation
             {
                 static int get(lua_State* L) {
-                    lua_pushinteger(L, *static_cast<T*>(lua_touserdata(L, lua_upvalueindex(1))));
+                    Pusher<T>::push(L, *static_cast<T*>(lua_touserdata(L, lua_upvalueindex(1))));
                     return 1;
                 }
                 static int set(lua_State* L) {
-                    *static_cast<T*>(lua_touserdata(L, lua_upvalueindex(1))) = LuaStack::getVariable<T>(L, 1);
+                    bool isOk = true;
+                    {
+                        //Out of range integers are rejected, clamped or wrapped as the type's LuaOverflow policy says
+                        T value = Getter<T>::get(L, 1, isOk);
+                        if(isOk)
+                            *static_cast<T*>(lua_touserdata(L, lua_upvalueindex(1))) = std::move(value);
+                    }
+                    
+                    //Raised once value is destroyed, the error doesn't unwind the stack
+                    if(!isOk)
+                        return luaL_argerror(L, 1, "value doesn't convert to the variable's type");
                     return 1;
                 }
             };
@@ -51,6 +61,42 @@ namespace LuaLink
             };
             
             extern void Register_Impl(Unsafe_VariableWrapper&&);
+            
+            template<typename T>
+            struct Synced
+            {
+                static void push(lua_State* L, void* pData) { Pusher<T>::push(L, *static_cast<T*>(pData)); }
+                
+                static bool read(lua_State* L, int idx, void* pData)
+                {
+                    bool isOk = true;
+                    T value = Getter<T>::get(L, idx, isOk);
+                    if(isOk)
+                        *static_cast<T*>(pData) = value;
+                    return isOk;
+                }
+            };
+            
+            //Type-erased access to a synced variable
+            struct SyncedVariable
+            {
+                template<typename T>
+                SyncedVariable(T* pVar, const char* name, const char* tableName) : Data(static_cast<void*>(pVar)),
+                Name(name),
+                TableName(tableName),
+                Push(Synced<T>::push),
+                Read(Synced<T>::read),
+                IsDirty(true) {}
+                
+                void* Data;
+                const char* Name;
+                const char* TableName; //nullptr for globals
+                void(*Push)(lua_State*, void*);
+                bool(*Read)(lua_State*, int, void*); //Returns false if the value can't be converted, the variable is left alone then
+                bool IsDirty;
+            };
+            
+            extern void RegisterSynced_Impl(SyncedVariable&&);
         }
     }
 
@@ -60,15 +106,48 @@ namespace LuaLink
 	{
         detail::LuaVariable::Register_Impl(detail::LuaVariable::Unsafe_VariableWrapper(&var, varName));
 	}
+
+	template<typename T>
+	void LuaVariable::RegisterSynced(T& var, const char* varName, const char* tableName)
+	{
+        detail::LuaVariable::RegisterSynced_Impl(detail::LuaVariable::SyncedVariable(&var, varName, tableName));
+	}
 }
 
 #ifdef LUALINK_DEFINE
 
 #include <vector>
+#include <unordered_map>
 
 namespace LuaLink {
     namespace detail {
         namespace LuaVariable {
+            //Synced variables live as long as the program, unlike variables to commit
+            std::vector<SyncedVariable>& SyncedVariables() {
+                static std::vector<SyncedVariable> s;
+                return s;
+            }
+            
+            //Address of a synced variable -> its index in SyncedVariables()
+            std::unordered_map<const void*, size_t>& SyncedVariableIndices() {
+                static std::unordered_map<const void*, size_t> s;
+                return s;
+            }
+            
+            //Registry key of the table holding the last value each synced variable had in Lua, keyed by address
+            static char s_SyncedValuesKey;
+            
+            void RegisterSynced_Impl(SyncedVariable&& v) {
+                auto it = SyncedVariableIndices().find(v.Data);
+                if(it != SyncedVariableIndices().end()){
+                    SyncedVariables()[it->second] = v;
+                    return;
+                }
+                
+                SyncedVariableIndices()[v.Data] = SyncedVariables().size();
+                SyncedVariables().push_back(v);
+            }
+
             //Temporary container for variables that haven't been commited yet
             std::vector<Unsafe_VariableWrapper>& VariablesToCommit() {
                 static std::vector<Unsafe_VariableWrapper> s;
@@ -117,6 +196,82 @@ namespace LuaLink {
         //Flush the cache of variables to commit so this can be re-used
         VariablesToCommit().clear();
     }
+    
+    void LuaVariable::MarkDirty_Impl(const void* pVar)
+    {
+        using namespace detail::LuaVariable;
+        
+        auto it = SyncedVariableIndices().find(pVar);
+        if(it != SyncedVariableIndices().end())
+            SyncedVariables()[it->second].IsDirty = true;
+    }
+    
+    void LuaVariable::Sync(lua_State* L)
+    {
+        using namespace detail::LuaVariable;
+        
+        if(SyncedVariables().empty())
+            return;
+        
+        int top = lua_gettop(L);
+        
+        //A new state hasn't seen any of the values yet
+        lua_rawgetp(L, LUA_REGISTRYINDEX, &s_SyncedValuesKey);
+        bool isNewState = !lua_istable(L, -1);
+        if(isNewState){
+            lua_pop(L, 1);
+            lua_newtable(L);
+            lua_pushvalue(L, -1);
+            lua_rawsetp(L, LUA_REGISTRYINDEX, &s_SyncedValuesKey);
+        }
+        int lastValues = lua_gettop(L);
+        
+        for(auto& var : SyncedVariables())
+        {
+            //Table the variable lives in
+            if(var.TableName){
+                lua_getglobal(L, var.TableName);
+                if(!lua_istable(L, -1)){
+                    var.IsDirty = true; //Written once the table exists
+                    lua_settop(L, lastValues);
+                    continue;
+                }
+            }
+            else
+                lua_pushglobaltable(L);
+            int table = lua_gettop(L);
+            
+            //Assigned from Lua since the last sync => copy back, unless C++ changed it as well (C++ wins)
+            //Tables (structs, containers) can be modified in place without a new assignment, those are read back every sync
+            if(!isNewState && !var.IsDirty){
+                lua_pushstring(L, var.Name);
+                lua_rawget(L, table);
+                lua_rawgetp(L, lastValues, var.Data);
+                
+                if(!lua_rawequal(L, -1, -2) || lua_istable(L, -2)){
+                    if(!var.Read(L, -2, var.Data))
+                        var.IsDirty = true; //Script stored something we can't convert, restore our value
+                    
+                    lua_pushvalue(L, -2);
+                    lua_rawsetp(L, lastValues, var.Data);
+                }
+                lua_pop(L, 2);
+            }
+            
+            if(isNewState || var.IsDirty){
+                lua_pushstring(L, var.Name);
+                var.Push(L, var.Data);
+                lua_pushvalue(L, -1);
+                lua_rawsetp(L, lastValues, var.Data);
+                lua_rawset(L, table);
+                var.IsDirty = false;
+            }
+            
+            lua_settop(L, lastValues);
+        }
+        
+        lua_settop(L, top);
+    }
 }
 #endif //LUALINK_DEFINE
 
@@ -10,6 +10,8 @@
 
 #include "LuaStack.hpp"
 #include <tuple>
+#include <cstring>
+#include <new>
 
 namespace LuaLink {
     namespace detail {
@@ -23,7 +25,7 @@ namespace LuaLink {
         {
             static std::tuple<T_Head> execute(lua_State* pLuaState, int argNum, bool& isOk, ArgErrorCbType onArgError, int& errRet)
             {
-                auto var = LuaStack::getVariable<T_Head>(pLuaState, argNum, isOk);
+                auto var = Getter<T_Head>::get(pLuaState, argNum, isOk);
                 if(!isOk)
                     errRet = onArgError(pLuaState, argNum);
                 
@@ -91,6 +93,88 @@ namespace LuaLink {
             return call_mem_impl<F, P, Tuple, 0 == std::tuple_size<typename std::decay<Tuple>::type>::value, std::tuple_size<typename std::decay<Tuple>::type>::value>::call(f, p, std::forward<Tuple>(t));
         }
         
+        //call_trusted (arguments are read straight from the Lua stack, without checks or an intermediate tuple)
+        template <typename F> struct trusted_args;
+        template <typename R, typename... A> struct trusted_args<R(*)(A...)> { typedef std::tuple<A...> type; };
+        template <typename R, typename C, typename... A> struct trusted_args<R(C::*)(A...)> { typedef std::tuple<A...> type; };
+        
+        template <typename F, bool Done, int Total, int... N>
+        struct call_trusted_impl
+        {
+            static auto call(lua_State* pLuaState, F f) -> decltype(call_trusted_impl<F, Total == 1 + sizeof...(N), Total, N..., sizeof...(N)>::call(pLuaState, f))
+            {
+                return call_trusted_impl<F, Total == 1 + sizeof...(N), Total, N..., sizeof...(N)>::call(pLuaState, f);
+            }
+        };
+        
+        template <typename F, int Total, int... N>
+        struct call_trusted_impl<F, true, Total, N...>
+        {
+            typedef typename trusted_args<F>::type Args;
+            
+            static auto call(lua_State* pLuaState, F f) -> decltype(f(TrustedReader<typename std::tuple_element<N, Args>::type>::get(pLuaState, N + 1)...))
+            {
+                return f(TrustedReader<typename std::tuple_element<N, Args>::type>::get(pLuaState, N + 1)...);
+            }
+        };
+        
+        template <typename F>
+        auto call_trusted(lua_State* pLuaState, F f) -> decltype(call_trusted_impl<F, 0 == std::tuple_size<typename trusted_args<F>::type>::value, std::tuple_size<typename trusted_args<F>::type>::value>::call(pLuaState, f))
+        {
+            return call_trusted_impl<F, 0 == std::tuple_size<typename trusted_args<F>::type>::value, std::tuple_size<typename trusted_args<F>::type>::value>::call(pLuaState, f);
+        }
+        
+        template <typename F, typename P, bool Done, int Total, int... N>
+        struct call_mem_trusted_impl
+        {
+            static auto call(lua_State* pLuaState, F f, P p) -> decltype(call_mem_trusted_impl<F, P, Total == 1 + sizeof...(N), Total, N..., sizeof...(N)>::call(pLuaState, f, p))
+            {
+                return call_mem_trusted_impl<F, P, Total == 1 + sizeof...(N), Total, N..., sizeof...(N)>::call(pLuaState, f, p);
+            }
+        };
+        
+        template <typename F, typename P, int Total, int... N>
+        struct call_mem_trusted_impl<F, P, true, Total, N...>
+        {
+            typedef typename trusted_args<F>::type Args;
+            
+            static auto call(lua_State* pLuaState, F f, P p) -> decltype((p->*f)(TrustedReader<typename std::tuple_element<N, Args>::type>::get(pLuaState, N + 1)...))
+            {
+                return (p->*f)(TrustedReader<typename std::tuple_element<N, Args>::type>::get(pLuaState, N + 1)...);
+            }
+        };
+        
+        template <typename F, typename P>
+        auto call_mem_trusted(lua_State* pLuaState, F f, P p) -> decltype(call_mem_trusted_impl<F, P, 0 == std::tuple_size<typename trusted_args<F>::type>::value, std::tuple_size<typename trusted_args<F>::type>::value>::call(pLuaState, f, p))
+        {
+            return call_mem_trusted_impl<F, P, 0 == std::tuple_size<typename trusted_args<F>::type>::value, std::tuple_size<typename trusted_args<F>::type>::value>::call(pLuaState, f, p);
+        }
+        
+        //construct (placement new with the elements of a tuple as constructor arguments)
+        template <typename T, typename Tuple, bool Done, int Total, int... N>
+        struct construct_impl
+        {
+            static T* construct(void* mem, Tuple && t)
+            {
+                return construct_impl<T, Tuple, Total == 1 + sizeof...(N), Total, N..., sizeof...(N)>::construct(mem, std::forward<Tuple>(t));
+            }
+        };
+        
+        template <typename T, typename Tuple, int Total, int... N>
+        struct construct_impl<T, Tuple, true, Total, N...>
+        {
+            static T* construct(void* mem, Tuple && t)
+            {
+                return new (mem) T(std::get<N>(std::forward<Tuple>(t))...);
+            }
+        };
+        
+        template <typename T, typename Tuple>
+        T* construct(void* mem, Tuple && t)
+        {
+            return construct_impl<T, Tuple, 0 == std::tuple_size<typename std::decay<Tuple>::type>::value, std::tuple_size<typename std::decay<Tuple>::type>::value>::construct(mem, std::forward<Tuple>(t));
+        }
+        
         struct CStrCmp {
             bool operator()(const char* a, const char* b) const;
         };